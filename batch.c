@@ -0,0 +1,575 @@
+/**************************************************************
+ *
+ *                     batch.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of batch mode. The jobs file is read up front
+ *              into a table of jobs, then each worker thread repeatedly
+ *              takes the next job from the table, loads its program into a
+ *              new machine whose input and output are the job's files, runs
+ *              it, and reports the time it took. Machines share nothing but
+ *              the process, so a job that halts only ends itself. With a
+ *              quantum, every job is loaded at once instead and the
+ *              scheduler interleaves them on the calling thread.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "batch.h"
+#include "machine.h"
+#include "image.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "mem.h"
+#include "assert.h"
+
+/********** Batch_job ********
+ *
+ * One line of the jobs file and what became of it.
+ *
+ *******************/
+typedef struct Batch_job {
+        struct Batch *batch;   /* the batch the job is in */
+        char *program;         /* the .um program or program image */
+        char *input;           /* file the program reads, "-" for none */
+        char *output;          /* file the program's output replaces */
+        size_t index;          /* place of the job in the file, from 0 */
+        int in_fd;             /* the open input, while the job runs */
+        int out_fd;            /* the open output, while the job runs */
+        double seconds;        /* time to load, run and free the job, or
+                                * the time its turns took if scheduled */
+        uint64_t instructions; /* instructions executed, if counted */
+        const char *error;     /* why the job did not run, or NULL */
+} Batch_job;
+
+/********** Batch ********
+ *
+ * Struct to hold the jobs and the state the workers share.
+ *
+ *******************/
+typedef struct Batch {
+        Batch_job *jobs;      /* every job, in the order of the file */
+        size_t num_jobs;      /* number of jobs */
+        size_t next;          /* next job a worker takes */
+        Um_options options;   /* how every job is run */
+        bool count;           /* whether instructions are counted */
+        pthread_mutex_t lock; /* guards next and the report */
+} Batch;
+
+/* Declarations for the helpers */
+static bool read_jobs(const char *jobs_path, Batch *batch);
+static void *run_worker(void *batch_arg);
+static void run_interleaved(Batch *batch);
+static bool retry_job(void *job_arg, Machine *vm);
+static void job_stopped(Machine vm, double seconds, void *job_arg);
+static void run_job(Batch *batch, Batch_job *job);
+static Machine start_job(Batch *batch, Batch_job *job, size_t *num_inst);
+static void finish_job(Batch_job *job, Machine vm);
+static int open_endpoint(const char *path, int flags);
+static void report_job(const Batch_job *job);
+static double elapsed_seconds(const struct timespec *start);
+
+/**************** run_batch ****************
+ *
+ * Runs every job in a jobs file on a pool of worker threads and prints a
+ * line on stdout for each job as it finishes, then one for the batch.
+ *
+ * Parameters:
+ *      const char *jobs_path: the jobs file. Each line names a program, the
+ *                             file it reads its input from ("-" for none)
+ *                             and the file its output is written to.
+ *                             Blank lines and lines starting with # are
+ *                             skipped.
+ *      int num_workers:       number of worker threads
+ *      Um_options options:    the engine each job runs on. With stats set,
+ *                             jobs run on the counting engine so that
+ *                             their MIPS can be reported. With a quantum,
+ *                             the jobs are interleaved on the calling
+ *                             thread instead, a turn of that many
+ *                             instructions at a time, on the scheduled
+ *                             threaded engine whatever the engine.
+ * Returns:
+ *      EXIT_SUCCESS if every job ran, EXIT_FAILURE otherwise
+ * Expects:
+ *      jobs_path is not NULL and num_workers is at least 1. Options that
+ *      act on the whole process (profile, checkpoints, restore) are not
+ *      set.
+ * Notes:
+ *      An input or output that is a Unix domain socket is connected to,
+ *      over one connection if the job's input and output are the same
+ *      socket. A FIFO is opened as any file is, waiting for its other end,
+ *      unless the jobs are interleaved: then a job whose output FIFO has
+ *      no reader yet is started once it has one, and a job whose input is
+ *      a FIFO runs once it has something to read, while the other jobs
+ *      run on.
+ *      A job whose files cannot be opened is reported and skipped. A job
+ *      whose program fails is reported as failed; on the switch and JIT
+ *      engines, whose checks are assertions, it ends the whole batch.
+ *
+ ********************************************/
+extern int run_batch(const char *jobs_path, int num_workers,
+                     Um_options options)
+{
+        assert(jobs_path != NULL && num_workers >= 1);
+        assert(!options.profile && options.checkpoint == NULL &&
+               options.restore == NULL);
+
+        Batch batch;
+        batch.next = 0;
+        batch.count = options.stats || options.quantum > 0;
+        options.stats = false;
+        options.report_fusion = false;
+        batch.options = options;
+        pthread_mutex_init(&batch.lock, NULL);
+        if (!read_jobs(jobs_path, &batch)) {
+                fprintf(stderr, "Error: Could not read jobs file %s\n",
+                        jobs_path);
+                return EXIT_FAILURE;
+        }
+        if ((size_t)num_workers > batch.num_jobs && batch.num_jobs > 0) {
+                num_workers = (int)batch.num_jobs;
+        }
+
+        /* Run the jobs, with the calling thread as the last worker, or
+         * as the only one if they are interleaved */
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int started = 1;
+        if (options.quantum > 0) {
+                run_interleaved(&batch);
+        } else {
+                pthread_t *workers = CALLOC(num_workers, sizeof(pthread_t));
+                while (started < num_workers &&
+                       pthread_create(&workers[started], NULL, run_worker,
+                                      &batch) == 0) {
+                        started++;
+                }
+                run_worker(&batch);
+                for (int i = 1; i < started; i++) {
+                        pthread_join(workers[i], NULL);
+                }
+                FREE(workers);
+        }
+        double seconds = elapsed_seconds(&start);
+
+        /* Report the whole batch */
+        size_t failed = 0;
+        uint64_t instructions = 0;
+        for (size_t i = 0; i < batch.num_jobs; i++) {
+                failed += batch.jobs[i].error != NULL;
+                instructions += batch.jobs[i].instructions;
+        }
+        printf("batch: %zu jobs, %zu failed, %.3f s on %d workers, "
+               "%.1f jobs/s", batch.num_jobs, failed, seconds, started,
+               seconds > 0 ? batch.num_jobs / seconds : 0.0);
+        if (batch.count) {
+                printf(", %.1f MIPS",
+                       seconds > 0 ? instructions / seconds / 1e6 : 0.0);
+        }
+        printf("\n");
+        fflush(stdout);
+
+        for (size_t i = 0; i < batch.num_jobs; i++) {
+                FREE(batch.jobs[i].program);
+        }
+        if (batch.jobs != NULL) {
+                FREE(batch.jobs);
+        }
+        pthread_mutex_destroy(&batch.lock);
+        return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**************** read_jobs ****************
+ *
+ * Reads the jobs file into the batch's table of jobs. The three names of a
+ * job point into one string that its program field owns.
+ *
+ ********************************************/
+static bool read_jobs(const char *jobs_path, Batch *batch)
+{
+        FILE *fp = fopen(jobs_path, "r");
+        if (fp == NULL) {
+                return false;
+        }
+
+        size_t capacity = 0;
+        batch->jobs = NULL;
+        batch->num_jobs = 0;
+        char *line = NULL;
+        size_t line_size = 0;
+        unsigned line_number = 0;
+        while (getline(&line, &line_size, fp) != -1) {
+                line_number++;
+                char *save = NULL;
+                char *fields[4];
+                fields[0] = strtok_r(line, " \t\r\n", &save);
+                if (fields[0] == NULL || fields[0][0] == '#') {
+                        continue;
+                }
+                for (int i = 1; i < 4; i++) {
+                        fields[i] = strtok_r(NULL, " \t\r\n", &save);
+                }
+                if (fields[2] == NULL || fields[3] != NULL) {
+                        fprintf(stderr, "Error: %s:%u: expected a program, "
+                                "an input and an output\n", jobs_path,
+                                line_number);
+                        exit(EXIT_FAILURE);
+                }
+
+                if (batch->num_jobs == capacity) {
+                        capacity = capacity == 0 ? 64 : capacity * 2;
+                        if (batch->jobs == NULL) {
+                                batch->jobs = ALLOC((long)capacity *
+                                                    sizeof(Batch_job));
+                        } else {
+                                RESIZE(batch->jobs, (long)capacity *
+                                                    sizeof(Batch_job));
+                        }
+                }
+
+                /* Keep the three names together in one copy */
+                size_t lengths[3];
+                for (int i = 0; i < 3; i++) {
+                        lengths[i] = strlen(fields[i]) + 1;
+                }
+                char *names = ALLOC(lengths[0] + lengths[1] + lengths[2]);
+                Batch_job *job = &batch->jobs[batch->num_jobs++];
+                job->program = memcpy(names, fields[0], lengths[0]);
+                job->input = memcpy(names + lengths[0], fields[1],
+                                    lengths[1]);
+                job->output = memcpy(names + lengths[0] + lengths[1],
+                                     fields[2], lengths[2]);
+                job->batch = batch;
+                job->index = batch->num_jobs - 1;
+                job->in_fd = -1;
+                job->out_fd = -1;
+                job->seconds = 0;
+                job->instructions = 0;
+                job->error = NULL;
+        }
+        free(line);
+        bool complete = ferror(fp) == 0;
+        fclose(fp);
+        return complete;
+}
+
+/**************** run_worker ****************
+ *
+ * Runs jobs until there are none left. Started as a thread for every
+ * worker but one, which is the thread that called run_batch.
+ *
+ ********************************************/
+static void *run_worker(void *batch_arg)
+{
+        Batch *batch = batch_arg;
+        for (;;) {
+                pthread_mutex_lock(&batch->lock);
+                size_t index = batch->next++;
+                pthread_mutex_unlock(&batch->lock);
+                if (index >= batch->num_jobs) {
+                        return NULL;
+                }
+
+                Batch_job *job = &batch->jobs[index];
+                run_job(batch, job);
+
+                pthread_mutex_lock(&batch->lock);
+                report_job(job);
+                pthread_mutex_unlock(&batch->lock);
+        }
+}
+
+/**************** run_interleaved ****************
+ *
+ * Loads every job onto a machine of its own and runs them all on the
+ * calling thread, a turn at a time, reporting each job as it stops.
+ *
+ ********************************************/
+static void run_interleaved(Batch *batch)
+{
+        /* Every job holds its input and output open at once, so allow as
+         * many descriptors as the system will */
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+            limit.rlim_cur < limit.rlim_max) {
+                limit.rlim_cur = limit.rlim_max;
+                setrlimit(RLIMIT_NOFILE, &limit);
+        }
+
+        /* A client that goes away must only end its own job */
+        signal(SIGPIPE, SIG_IGN);
+
+        Scheduler scheduler = new_scheduler(batch->options.quantum,
+                                            job_stopped);
+        for (size_t i = 0; i < batch->num_jobs; i++) {
+                Batch_job *job = &batch->jobs[i];
+                size_t num_inst;
+                Machine vm = start_job(batch, job, &num_inst);
+                if (vm != NULL) {
+                        schedule_machine(scheduler, vm, job);
+                } else if (job->error == NULL) {
+                        schedule_start(scheduler, retry_job, job);
+                } else {
+                        report_job(job);
+                }
+        }
+        run_scheduler(scheduler);
+        free_scheduler(&scheduler);
+}
+
+/**************** retry_job ****************
+ *
+ * Tries again to start an interleaved job whose output FIFO had no reader,
+ * reporting the job if it cannot run.
+ *
+ ********************************************/
+static bool retry_job(void *job_arg, Machine *vm)
+{
+        Batch_job *job = job_arg;
+        size_t num_inst;
+        *vm = start_job(job->batch, job, &num_inst);
+        if (*vm == NULL && job->error != NULL) {
+                report_job(job);
+        }
+        return *vm != NULL || job->error != NULL;
+}
+
+/**************** job_stopped ****************
+ *
+ * Finishes and reports a job whose machine the scheduler has stopped.
+ *
+ ********************************************/
+static void job_stopped(Machine vm, double seconds, void *job_arg)
+{
+        Batch_job *job = job_arg;
+        finish_job(job, vm);
+        job->seconds = seconds;
+        report_job(job);
+}
+
+/**************** run_job ****************
+ *
+ * Runs one job on a new machine, recording how long it took, or why it
+ * could not run.
+ *
+ ********************************************/
+static void run_job(Batch *batch, Batch_job *job)
+{
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        size_t num_inst;
+        Machine vm = start_job(batch, job, &num_inst);
+        if (vm == NULL) {
+                return;
+        }
+        run_machine(vm, num_inst, batch->options);
+        finish_job(job, vm);
+        job->seconds = elapsed_seconds(&start);
+}
+
+/**************** start_job ****************
+ *
+ * Opens the files of a job and loads its program into a new machine whose
+ * input and output are those files.
+ *
+ * Parameters:
+ *      Batch *batch:     the batch the job is in
+ *      Batch_job *job:   the job
+ *      size_t *num_inst: set to the number of instructions in the program
+ * Returns:
+ *      the machine, or NULL with the job's error set if a file could not
+ *      be opened. If the jobs are interleaved, the files are opened without
+ *      waiting, and NULL with no error set means the output is a FIFO with
+ *      no reader yet, and nothing was opened.
+ *
+ ********************************************/
+static Machine start_job(Batch *batch, Batch_job *job, size_t *num_inst)
+{
+        /* Open the program */
+        struct stat statistics;
+        bool image = is_image(job->program);
+        FILE *fp = image ? NULL : fopen(job->program, "rb");
+        if (!image && (fp == NULL || fstat(fileno(fp), &statistics) != 0 ||
+                       statistics.st_size % 4 != 0)) {
+                job->error = "could not read the program";
+                if (fp != NULL) {
+                        fclose(fp);
+                }
+                return NULL;
+        }
+
+        /* The scheduler must not wait for the other end of a FIFO. The
+         * output is opened first, so that a job waiting for a reader has
+         * not opened its input, whose writer would see it go away */
+        int nonblocking = batch->options.quantum > 0 ? O_NONBLOCK : 0;
+        const char *input = strcmp(job->input, "-") == 0 ? "/dev/null" :
+                                                           job->input;
+        struct stat in_info;
+        bool one_socket = strcmp(job->output, input) == 0 &&
+                          stat(input, &in_info) == 0 &&
+                          S_ISSOCK(in_info.st_mode);
+        int out_fd = -1;
+        if (!one_socket) {
+                out_fd = open_endpoint(job->output, O_WRONLY | O_CREAT |
+                                                    O_TRUNC | nonblocking);
+                if (out_fd < 0 && errno == ENXIO && nonblocking != 0) {
+                        if (fp != NULL) {
+                                fclose(fp);
+                        }
+                        return NULL;
+                }
+        }
+
+        /* A job whose input and output are the same socket talks to it
+         * over one connection */
+        int in_fd = -1;
+        if (out_fd < 0 && !one_socket) {
+                job->error = "could not open the output";
+        } else if ((in_fd = open_endpoint(input, O_RDONLY |
+                                                 nonblocking)) < 0) {
+                job->error = "could not open the input";
+        } else if (one_socket && (out_fd = dup(in_fd)) < 0) {
+                job->error = "could not open the output";
+        }
+        if (job->error != NULL) {
+                if (fp != NULL) {
+                        fclose(fp);
+                }
+                if (in_fd >= 0) {
+                        close(in_fd);
+                }
+                if (out_fd >= 0) {
+                        close(out_fd);
+                }
+                return NULL;
+        }
+
+        /* Load the program on a machine of its own */
+        Machine vm = new_machine_io(batch->options.output_mode, in_fd,
+                                    out_fd);
+        if (image) {
+                *num_inst = load_image(job->program, vm->space);
+        } else {
+                *num_inst = (size_t)statistics.st_size / 4;
+                read_instructions(fp, vm->space, *num_inst);
+        }
+        if (batch->count && batch->options.quantum == 0) {
+                vm->stats = new_stats(false, false);
+        }
+        job->in_fd = in_fd;
+        job->out_fd = out_fd;
+        return vm;
+}
+
+/**************** finish_job ****************
+ *
+ * Records what became of a job whose machine has stopped, then frees the
+ * machine and closes the job's files.
+ *
+ ********************************************/
+static void finish_job(Batch_job *job, Machine vm)
+{
+        job->error = vm->failure;
+        if (vm->stats != NULL) {
+                for (int op = 0; op < NUM_OPCODES; op++) {
+                        job->instructions += vm->stats->opcodes[op];
+                }
+        } else {
+                job->instructions = vm->instructions;
+        }
+        free_machine(&vm);
+        close(job->in_fd);
+        close(job->out_fd);
+        job->in_fd = -1;
+        job->out_fd = -1;
+}
+
+/**************** open_endpoint ****************
+ *
+ * Opens the input or output of a job. A Unix domain socket is connected
+ * to, and any other file is opened with the given flags.
+ *
+ * Parameters:
+ *      const char *path: the file
+ *      int flags:        flags for open(2)
+ * Returns:
+ *      the file descriptor, or -1 if it could not be opened
+ *
+ ********************************************/
+static int open_endpoint(const char *path, int flags)
+{
+        struct stat info;
+        if (stat(path, &info) != 0 || !S_ISSOCK(info.st_mode)) {
+                return open(path, flags, 0666);
+        }
+
+        struct sockaddr_un address;
+        size_t length = strlen(path);
+        if (length >= sizeof(address.sun_path)) {
+                return -1;
+        }
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path, length + 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&address,
+                               sizeof(address)) != 0) {
+                close(fd);
+                fd = -1;
+        }
+        return fd;
+}
+
+/**************** report_job ****************
+ *
+ * Prints the line for one finished job on stdout.
+ *
+ ********************************************/
+static void report_job(const Batch_job *job)
+{
+        size_t index = job->index;
+        if (job->error != NULL) {
+                printf("job %zu %s: failed, %s\n", index + 1, job->program,
+                       job->error);
+        } else if (job->instructions > 0) {
+                printf("job %zu %s: %.3f s, %llu instructions, %.1f MIPS\n",
+                       index + 1, job->program, job->seconds,
+                       (unsigned long long)job->instructions,
+                       job->seconds > 0 ?
+                       job->instructions / job->seconds / 1e6 : 0.0);
+        } else {
+                printf("job %zu %s: %.3f s\n", index + 1, job->program,
+                       job->seconds);
+        }
+        fflush(stdout);
+}
+
+/**************** elapsed_seconds ****************
+ *
+ * Returns the seconds since the given time on the monotonic clock.
+ *
+ ********************************************/
+static double elapsed_seconds(const struct timespec *start)
+{
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        return (end.tv_sec - start->tv_sec) +
+               (end.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,27 @@
+/**************************************************************
+ *
+ *                     batch.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Declaration of batch mode, which runs many independent UM
+ *              programs from a list of jobs on a pool of worker threads,
+ *              each job on its own machine, and reports how fast each job
+ *              and the whole batch ran.
+ * 
+ **************************************************************/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "read_and_execute.h"
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern int run_batch(const char *jobs_path, int num_workers,
+                     Um_options options);
+
+#endif
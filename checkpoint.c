@@ -0,0 +1,407 @@
+/**************************************************************
+ *
+ *                     checkpoint.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of checkpoints. A checkpoint file is written
+ *              in host byte order as a header (registers, program counter,
+ *              counts), a directory giving where each segment ID is stored,
+ *              the stack of unmapped IDs, the words of the short segments
+ *              packed together, and finally the long segments, each stored
+ *              as a whole Segment starting on a page boundary. Restoring
+ *              copies the short segments out of a read-only mapping of the
+ *              file and maps each long segment privately from the file, so
+ *              its pages are only read when the program touches them.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "segment_private.h"
+#include "mem.h"
+#include "assert.h"
+
+/* Identifies a checkpoint file and the version of its layout */
+#define CHECKPOINT_MAGIC "UMCHKPT"
+#define CHECKPOINT_VERSION 1
+
+/* Written as a word so a file from a host of the other byte order is
+ * recognized */
+#define CHECKPOINT_BYTE_ORDER 0x01020304
+
+/* Segments of at least this many words are stored page aligned and mapped
+ * from the file on restore; shorter ones are copied */
+#ifndef CHECKPOINT_MAP_LENGTH
+#define CHECKPOINT_MAP_LENGTH 4096
+#endif
+
+/********** Checkpoint_header ********
+ *
+ * The start of a checkpoint file.
+ *
+ *******************/
+typedef struct Checkpoint_header {
+        char magic[8];                     /* CHECKPOINT_MAGIC */
+        uint32_t version;                  /* CHECKPOINT_VERSION */
+        uint32_t byte_order;               /* CHECKPOINT_BYTE_ORDER */
+        uint32_t page_size;                /* alignment of long segments */
+        uint32_t prog_counter;             /* next instruction to execute */
+        uint32_t registers[NUM_REGISTERS]; /* registers 0 - 7 */
+        uint32_t num_segments;             /* entries in the directory */
+        uint32_t num_unmapped;             /* IDs on the unmapped stack */
+        uint64_t file_size;                /* bytes in the whole file */
+} Checkpoint_header;
+
+/* How the segment at one ID is stored: its words packed with the other
+ * short segments, as a whole page-aligned Segment, or not at all because
+ * the ID shares the 0 segment */
+#define ENTRY_COPIED 0
+#define ENTRY_MAPPED 1
+#define ENTRY_SHARED 2
+
+/********** Checkpoint_entry ********
+ *
+ * Where the segment at one ID is stored. A mapped segment's offset is that
+ * of its Segment, a copied segment's is that of its words.
+ *
+ *******************/
+typedef struct Checkpoint_entry {
+        uint64_t offset;  /* byte offset in the file, 0 if unmapped */
+        uint32_t length;  /* number of words in the segment */
+        uint32_t kind;    /* ENTRY_COPIED, ENTRY_MAPPED or ENTRY_SHARED */
+} Checkpoint_entry;
+
+volatile sig_atomic_t checkpoint_requested = 0;
+uint64_t checkpoint_at = 0;
+
+/* File each checkpoint is written to */
+static const char *checkpoint_path = NULL;
+
+/* Declarations for the helpers */
+static void request_checkpoint(int signal_number);
+static void write_padding(FILE *fp, uint64_t *offset, uint64_t alignment);
+static void bad_checkpoint(const char *path);
+
+/**************** start_checkpoints ****************
+ *
+ * Sets the file checkpoints are written to and when the engine writes one
+ * by itself, and installs a SIGUSR1 handler that asks for one.
+ *
+ * Parameters:
+ *      const char *path: the checkpoint file, overwritten by each checkpoint
+ *      uint64_t at:      number of instructions after which to write one,
+ *                        or 0 for none
+ * Returns:
+ *      None
+ * Expects:
+ *      path is not NULL and outlives the run.
+ *
+ ********************************************/
+extern void start_checkpoints(const char *path, uint64_t at)
+{
+        assert(path != NULL);
+        checkpoint_path = path;
+        checkpoint_at = at;
+        checkpoint_requested = 0;
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = request_checkpoint;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGUSR1, &action, NULL);
+}
+
+/**************** write_checkpoint ****************
+ *
+ * Writes the registers, program counter and address space of the machine
+ * to the checkpoint file, replacing it once the new one is complete.
+ *
+ * Parameters:
+ *      Machine vm: the machine, whose registers and prog_counter are
+ *                  current
+ * Returns:
+ *      None
+ * Expects:
+ *      start_checkpoints was called. vm is not NULL.
+ * Notes:
+ *      The output written so far is flushed first. Input is not part of a
+ *      checkpoint: a restored run reads its own stdin. If the file cannot be
+ *      written, an error is printed on stderr and the run goes on.
+ *
+ ********************************************/
+extern void write_checkpoint(Machine vm)
+{
+        assert(vm != NULL && checkpoint_path != NULL);
+        checkpoint_requested = 0;
+        flush_output(vm->out);
+
+        Address_space space = vm->space;
+        uint32_t num_segments = space->num_segments;
+        uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+
+        Checkpoint_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+        header.version = CHECKPOINT_VERSION;
+        header.byte_order = CHECKPOINT_BYTE_ORDER;
+        header.page_size = (uint32_t)page_size;
+        header.prog_counter = vm->prog_counter;
+        memcpy(header.registers, vm->registers, sizeof(header.registers));
+        header.num_segments = num_segments;
+        header.num_unmapped = space->num_unmapped;
+
+        /* Lay out the short segments after the directory and the unmapped
+         * IDs, then the long ones on page boundaries. Only the 0 segment
+         * can be shared, with the segment a LOADP made it an alias of */
+        Checkpoint_entry *entries = CALLOC(num_segments,
+                                           sizeof(Checkpoint_entry));
+        uint64_t offset = sizeof(header) +
+                          num_segments * sizeof(Checkpoint_entry) +
+                          space->num_unmapped * sizeof(uint32_t);
+        for (int pass = 0; pass < 2; pass++) {
+                if (pass == 1) {
+                        offset = (offset + page_size - 1) / page_size *
+                                 page_size;
+                }
+                for (uint32_t ID = 0; ID < num_segments; ID++) {
+                        Segment *seg = space->segments[ID];
+                        bool is_long = seg != NULL &&
+                                       seg->length >= CHECKPOINT_MAP_LENGTH;
+                        if (seg == NULL || is_long != (pass == 1)) {
+                                continue;
+                        }
+                        if (ID != 0 && seg == space->segments[0]) {
+                                entries[ID] = entries[0];
+                                entries[ID].kind = ENTRY_SHARED;
+                                continue;
+                        }
+                        entries[ID].offset = offset;
+                        entries[ID].length = seg->length;
+                        entries[ID].kind = is_long ? ENTRY_MAPPED :
+                                                     ENTRY_COPIED;
+                        if (is_long) {
+                                uint64_t bytes = sizeof(Segment) +
+                                        (uint64_t)seg->length *
+                                        sizeof(uint32_t);
+                                offset += (bytes + page_size - 1) /
+                                          page_size * page_size;
+                        } else {
+                                offset += (uint64_t)seg->length *
+                                          sizeof(uint32_t);
+                        }
+                }
+        }
+        header.file_size = offset;
+
+        /* Write to a temporary file so a failed write leaves the last
+         * checkpoint in place */
+        size_t path_length = strlen(checkpoint_path) + sizeof(".tmp");
+        char *temp_path = ALLOC(path_length);
+        snprintf(temp_path, path_length, "%s.tmp", checkpoint_path);
+        FILE *fp = fopen(temp_path, "wb");
+        if (fp == NULL) {
+                fprintf(stderr, "Error: Could not write checkpoint %s\n",
+                        temp_path);
+                FREE(temp_path);
+                FREE(entries);
+                return;
+        }
+
+        fwrite(&header, sizeof(header), 1, fp);
+        fwrite(entries, sizeof(Checkpoint_entry), num_segments, fp);
+        fwrite(space->unmapped, sizeof(uint32_t), space->num_unmapped, fp);
+        offset = sizeof(header) + num_segments * sizeof(Checkpoint_entry) +
+                 space->num_unmapped * sizeof(uint32_t);
+
+        for (int pass = 0; pass < 2; pass++) {
+                if (pass == 1) {
+                        write_padding(fp, &offset, page_size);
+                }
+                for (uint32_t ID = 0; ID < num_segments; ID++) {
+                        Segment *seg = space->segments[ID];
+                        if (seg == NULL || entries[ID].kind != (uint32_t)pass) {
+                                continue;
+                        }
+                        if (pass == 1) {
+                                /* A long segment is stored whole, marked
+                                 * as mapped storage */
+                                Segment image = { 1, seg->length,
+                                                  seg->length, 1 };
+                                fwrite(&image, sizeof(Segment), 1, fp);
+                                offset += sizeof(Segment);
+                        }
+                        fwrite(seg->words, sizeof(uint32_t), seg->length, fp);
+                        offset += (uint64_t)seg->length * sizeof(uint32_t);
+                        if (pass == 1) {
+                                write_padding(fp, &offset, page_size);
+                        }
+                }
+        }
+
+        bool written = ferror(fp) == 0;
+        if (fclose(fp) != 0 || !written || offset != header.file_size ||
+            rename(temp_path, checkpoint_path) != 0) {
+                fprintf(stderr, "Error: Could not write checkpoint %s\n",
+                        checkpoint_path);
+                remove(temp_path);
+        }
+        FREE(temp_path);
+        FREE(entries);
+}
+
+/**************** restore_checkpoint ****************
+ *
+ * Fills a new machine with the registers, program counter and address space
+ * stored in a checkpoint file, and decodes its 0 segment.
+ *
+ * Parameters:
+ *      const char *path: the checkpoint file
+ *      Machine vm:       a machine with no segments mapped
+ * Returns:
+ *      the number of instructions in the restored 0 segment
+ * Expects:
+ *      path names a checkpoint written on a host of the same byte order,
+ *      exits with an error message if not.
+ * Notes:
+ *      Long segments are private mappings of the file, so writes to them
+ *      never reach the file, and the file may be replaced or removed once
+ *      this returns.
+ *
+ ********************************************/
+extern size_t restore_checkpoint(const char *path, Machine vm)
+{
+        assert(path != NULL && vm != NULL);
+
+        int fd = open(path, O_RDONLY);
+        struct stat statistics;
+        if (fd < 0 || fstat(fd, &statistics) != 0 ||
+            (size_t)statistics.st_size < sizeof(Checkpoint_header)) {
+                bad_checkpoint(path);
+        }
+        uint64_t size = (uint64_t)statistics.st_size;
+        const unsigned char *image = mmap(NULL, size, PROT_READ, MAP_PRIVATE,
+                                          fd, 0);
+        if (image == MAP_FAILED) {
+                bad_checkpoint(path);
+        }
+
+        /* Check the header and that the directory lies inside the file */
+        const Checkpoint_header *header = (const Checkpoint_header *)image;
+        uint32_t num_segments = header->num_segments;
+        uint32_t num_unmapped = header->num_unmapped;
+        uint64_t tables = sizeof(Checkpoint_header) +
+                          (uint64_t)num_segments * sizeof(Checkpoint_entry) +
+                          (uint64_t)num_unmapped * sizeof(uint32_t);
+        if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic))
+            != 0 || header->version != CHECKPOINT_VERSION ||
+            header->byte_order != CHECKPOINT_BYTE_ORDER ||
+            header->file_size != size || num_segments == 0 ||
+            tables > size) {
+                bad_checkpoint(path);
+        }
+        const Checkpoint_entry *entries =
+                (const Checkpoint_entry *)(header + 1);
+        const uint32_t *unmapped = (const uint32_t *)(entries + num_segments);
+        if (entries[0].offset == 0) {
+                bad_checkpoint(path);
+        }
+
+        memcpy(vm->registers, header->registers, sizeof(vm->registers));
+        vm->prog_counter = header->prog_counter;
+
+        Segment **segments = ALLOC((long)num_segments * sizeof(Segment *));
+        for (uint32_t ID = 0; ID < num_segments; ID++) {
+                const Checkpoint_entry *entry = &entries[ID];
+                uint64_t bytes = (uint64_t)entry->length * sizeof(uint32_t);
+                uint64_t words_offset = entry->offset +
+                        (entry->kind == ENTRY_MAPPED ? sizeof(Segment) : 0);
+                if (entry->offset == 0) {
+                        segments[ID] = NULL;
+                        continue;
+                }
+                if (entry->offset < tables || words_offset + bytes > size ||
+                    entry->kind > ENTRY_SHARED) {
+                        bad_checkpoint(path);
+                }
+
+                /* An ID sharing the 0 segment gets another reference */
+                if (entry->kind == ENTRY_SHARED) {
+                        if (ID == 0 || segments[0] == NULL) {
+                                bad_checkpoint(path);
+                        }
+                        segments[ID] = segments[0];
+                        segments[0]->refs++;
+                        continue;
+                }
+
+                /* Map long segments straight from the file, copy the rest */
+                Segment *seg = NULL;
+                if (entry->kind == ENTRY_MAPPED) {
+                        seg = map_file_segment(fd, entry->offset,
+                                               entry->length);
+                }
+                if (seg == NULL) {
+                        seg = allocate_segment(vm->space, entry->length);
+                        memcpy(seg->words, image + words_offset, bytes);
+                }
+                segments[ID] = seg;
+        }
+
+        install_segments(vm->space, segments, num_segments, unmapped,
+                         num_unmapped);
+        size_t num_inst = segments[0]->length;
+        FREE(segments);
+        munmap((void *)image, size);
+        close(fd);
+
+        decode_program(vm->space);
+        return num_inst;
+}
+
+/**************** request_checkpoint ****************
+ *
+ * SIGUSR1 handler that asks the engine for a checkpoint.
+ *
+ ********************************************/
+static void request_checkpoint(int signal_number)
+{
+        (void)signal_number;
+        checkpoint_requested = 1;
+}
+
+/**************** write_padding ****************
+ *
+ * Writes zero bytes up to the next multiple of alignment, advancing the
+ * offset of the stream to match.
+ *
+ ********************************************/
+static void write_padding(FILE *fp, uint64_t *offset, uint64_t alignment)
+{
+        while (*offset % alignment != 0) {
+                fputc(0, fp);
+                (*offset)++;
+        }
+}
+
+/**************** bad_checkpoint ****************
+ *
+ * Prints an error about the given checkpoint file and exits with a failure
+ * status.
+ *
+ ********************************************/
+static void bad_checkpoint(const char *path)
+{
+        fprintf(stderr, "Error: %s is not a checkpoint um can restore\n",
+                path);
+        exit(EXIT_FAILURE);
+}
@@ -0,0 +1,40 @@
+/**************************************************************
+ *
+ *                     checkpoint.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Declarations for writing a running machine to a checkpoint
+ *              file and starting a later run from one. A checkpoint holds
+ *              the registers, the program counter, every mapped segment and
+ *              the stack of unmapped IDs, laid out so that long segments
+ *              can be mapped straight from the file when it is restored.
+ * 
+ **************************************************************/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <signal.h>
+#include "machine.h"
+
+/* Set by the SIGUSR1 handler to ask the checkpointing engine to write a
+ * checkpoint before the next instruction */
+extern volatile sig_atomic_t checkpoint_requested;
+
+/* Number of instructions after which the checkpointing engine writes a
+ * checkpoint, or 0 to write one only when asked by SIGUSR1 */
+extern uint64_t checkpoint_at;
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern void start_checkpoints(const char *path, uint64_t at);
+extern void write_checkpoint(Machine vm);
+extern size_t restore_checkpoint(const char *path, Machine vm);
+
+#endif
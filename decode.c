@@ -0,0 +1,115 @@
+/**************************************************************
+ *
+ *                     decode.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of the functions that decode 32-bit UM words
+ *              into Um_decoded records. The fields are the same ones the
+ *              getters in read_and_execute return, extracted with shifts and
+ *              masks since every word of the 0 segment passes through here.
+ *              Decoding also marks the first instruction of each frequent
+ *              pair (SLOAD+ADD, NAND+NAND, LV+ADD, LV+LOADP) with a fused
+ *              opcode.
+ * 
+ **************************************************************/
+
+#include <stddef.h>
+#include "decode.h"
+
+/**************** decode_instruction ****************
+ * 
+ * Decodes a single 32-bit word into its opcode and operand fields.
+ *
+ * Parameters:
+ *      uint32_t word: the instruction to decode
+ * Returns:
+ *      a Um_decoded record holding the fields of the instruction
+ * Expects:
+ *      None. Words with an invalid opcode are decoded as they are and are
+ *      rejected by the execution engines if they are ever executed.
+ *
+ ********************************************/
+extern Um_decoded decode_instruction(uint32_t word)
+{
+        Um_decoded decoded;
+        decoded.op = word >> 28;
+
+        if (decoded.op == LV) {
+                decoded.a = (word >> 25) & 0x7;
+                decoded.b = 0;
+                decoded.c = 0;
+                decoded.val = word & 0x1FFFFFF;
+        } else {
+                decoded.a = (word >> 6) & 0x7;
+                decoded.b = (word >> 3) & 0x7;
+                decoded.c = word & 0x7;
+                decoded.val = 0;
+        }
+        return decoded;
+}
+
+/**************** decode_words ****************
+ * 
+ * Decodes count consecutive words into the given array of records, fusing
+ * each record with the next where they form a frequent pair.
+ *
+ * Parameters:
+ *      Um_decoded *decoded:   array of at least count records to fill
+ *      const uint32_t *words: array of at least count words to decode
+ *      size_t count:          number of words to decode
+ * Returns:
+ *      None
+ * Expects:
+ *      decoded and words are not NULL unless count is 0.
+ *
+ ********************************************/
+extern void decode_words(Um_decoded *decoded, const uint32_t *words,
+                         size_t count)
+{
+        for (size_t i = 0; i < count; i++) {
+                decoded[i] = decode_instruction(words[i]);
+        }
+        for (size_t i = 1; i < count; i++) {
+                fuse_pair(&decoded[i - 1], &decoded[i]);
+        }
+}
+
+/**************** fuse_pair ****************
+ * 
+ * Sets the opcode of a decoded record to the fused opcode for it and the
+ * record after it, or back to its own opcode if the two are not a pair that
+ * is fused.
+ *
+ * Parameters:
+ *      Um_decoded *first:        the record whose opcode is set
+ *      const Um_decoded *second: the record that follows it in the program
+ * Returns:
+ *      None
+ * Expects:
+ *      first and second are not NULL.
+ * Notes:
+ *      Only the opcode of first changes. The fused handlers read the second
+ *      instruction from its own record, which is left as it is so that a
+ *      jump to the second instruction executes it on its own.
+ *
+ ********************************************/
+extern void fuse_pair(Um_decoded *first, const Um_decoded *second)
+{
+        uint8_t op = first->op & OPCODE_MASK;
+        uint8_t next = second->op & OPCODE_MASK;
+
+        if (op == SLOAD && next == ADD) {
+                first->op = FUSED_SLOAD_ADD;
+        } else if (op == NAND && next == NAND) {
+                first->op = FUSED_NAND_NAND;
+        } else if (op == LV && next == ADD) {
+                first->op = FUSED_LV_ADD;
+        } else if (op == LV && next == LOADP) {
+                first->op = FUSED_LV_LOADP;
+        } else {
+                first->op = op;
+        }
+}
@@ -0,0 +1,78 @@
+/**************************************************************
+ *
+ *                     decode.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Declaration of the UM opcodes, the pre-decoded instruction
+ *              record and the function that decodes a 32-bit UM word into
+ *              one. The address space keeps the 0 segment decoded into an
+ *              array of these records so that the execution engines never
+ *              unpack fields while running. Frequent pairs of instructions
+ *              are fused at decode time so that the engines can run them
+ *              with a single dispatch.
+ * 
+ **************************************************************/
+
+#ifndef DECODE_H
+#define DECODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/********** Um_opcode ********
+ * 
+ * Enum to hold all the possible opcodes for the instructions that can be 
+ * executed by the Universal Machine.
+ *
+ *******************/
+typedef enum Um_opcode {
+        CMOV = 0, SLOAD, SSTORE, ADD, MUL, DIV,
+        NAND, HALT, MAP, UNMAP, OUT, IN, LOADP, LV
+} Um_opcode;
+
+/********** Um_decoded ********
+ * 
+ * Struct to hold one decoded instruction. For a load value instruction, a is
+ * the register named by the three bits under the opcode and val is the
+ * 25-bit value; for every other instruction a, b and c are the three
+ * register fields and val is 0.
+ *
+ *******************/
+typedef struct Um_decoded {
+        uint8_t op;   /* opcode, 0 - 15, or a fused opcode */
+        uint8_t a;    /* register A (or the load value register) */
+        uint8_t b;    /* register B */
+        uint8_t c;    /* register C */
+        uint32_t val; /* value for load value instructions */
+} Um_decoded;
+
+/* Opcodes that mark the first instruction of a fused pair. The low four
+ * bits of a fused opcode are the opcode of the first instruction, and the
+ * second instruction keeps its own record, so a jump to it runs it alone */
+#define OPCODE_MASK 0xF
+#define FUSED_SLOAD_ADD 0x11 /* segment load, then add */
+#define FUSED_NAND_NAND 0x16 /* nand, then nand */
+#define FUSED_LV_ADD    0x1D /* load value, then add */
+#define FUSED_LV_LOADP  0x2D /* load value, then load program */
+
+/* Number of values a decoded opcode can take */
+#define NUM_DECODED_OPS 48
+
+/* Kinds of fused pair, in the order they are counted */
+typedef enum Um_fusion {
+        PAIR_SLOAD_ADD = 0, PAIR_NAND_NAND, PAIR_LV_ADD, PAIR_LV_LOADP,
+        NUM_FUSIONS
+} Um_fusion;
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern Um_decoded decode_instruction(uint32_t word);
+extern void decode_words(Um_decoded *decoded, const uint32_t *words,
+                                                                 size_t count);
+extern void fuse_pair(Um_decoded *first, const Um_decoded *second);
+
+#endif
@@ -0,0 +1,385 @@
+/**************************************************************
+ *
+ *                     image.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of program images. An image is written in
+ *              host byte order as a header, which names the .um file it was
+ *              compiled from with that file's size, modification time and
+ *              checksum, then the 0 segment stored as a whole Segment
+ *              starting on a page boundary, then the decoded records of the
+ *              0 segment, also page aligned. Loading maps both privately
+ *              from the image, so no word is converted or decoded and the
+ *              pages are only read when the program touches them.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "image.h"
+#include "segment_private.h"
+#include "read_and_execute.h"
+#include "mem.h"
+#include "assert.h"
+
+/* Identifies an image and the version of its layout. The version must
+ * change whenever decoding or fusion changes, since the records are stored
+ * as decoded */
+#define IMAGE_MAGIC "UMCIMG"
+#define IMAGE_VERSION 1
+
+/* Written as a word so an image from a host of the other byte order is
+ * recognized */
+#define IMAGE_BYTE_ORDER 0x01020304
+
+/* Room for the absolute path of the source in the header */
+#define IMAGE_PATH_LENGTH 4096
+
+/* FNV-1a parameters for the checksum of the source */
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+/********** Image_header ********
+ *
+ * The start of a program image.
+ *
+ *******************/
+typedef struct Image_header {
+        char magic[8];            /* IMAGE_MAGIC */
+        uint32_t version;         /* IMAGE_VERSION */
+        uint32_t byte_order;      /* IMAGE_BYTE_ORDER */
+        uint32_t record_size;     /* sizeof(Um_decoded) when written */
+        uint32_t num_words;       /* number of words in the 0 segment */
+        uint64_t words_offset;    /* where the Segment starts */
+        uint64_t decoded_offset;  /* where the decoded records start */
+        uint64_t file_size;       /* bytes in the whole image */
+        uint64_t source_size;     /* bytes in the source when compiled */
+        int64_t source_mtime;     /* its modification time, seconds */
+        int64_t source_mtime_ns;  /* and nanoseconds */
+        uint64_t source_checksum; /* FNV-1a hash of its bytes */
+        char source_path[IMAGE_PATH_LENGTH]; /* its absolute path */
+} Image_header;
+
+/* Declarations for the helpers */
+static bool checksum_file(const char *path, uint64_t *checksum);
+static bool is_stale(const Image_header *header);
+static size_t load_source(const char *path, Address_space space);
+static void write_padding(FILE *fp, uint64_t *offset, uint64_t alignment);
+static void bad_image(const char *path);
+
+/**************** compile_image ****************
+ *
+ * Reads and decodes a .um program and writes it to an image.
+ *
+ * Parameters:
+ *      const char *source: the .um file
+ *      const char *image:  the image to write, replaced once it is complete
+ * Returns:
+ *      None
+ * Expects:
+ *      source and image are not NULL. Exits with an error message if the
+ *      source cannot be read or the image cannot be written.
+ *
+ ********************************************/
+extern void compile_image(const char *source, const char *image)
+{
+        assert(source != NULL && image != NULL);
+
+        Image_header *header = CALLOC(1, sizeof(Image_header));
+        struct stat statistics;
+        if (stat(source, &statistics) != 0 || statistics.st_size % 4 != 0 ||
+            statistics.st_size / 4 > UINT32_MAX ||
+            realpath(source, header->source_path) == NULL ||
+            !checksum_file(source, &header->source_checksum)) {
+                fprintf(stderr, "Error: Could not compile %s\n", source);
+                exit(EXIT_FAILURE);
+        }
+
+        /* Decode the program exactly as um would before running it */
+        Address_space space = new_address_space();
+        size_t num_words = load_source(source, space);
+        Segment *program = space->segments[0];
+
+        uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+        uint64_t segment_bytes = sizeof(Segment) +
+                                 (uint64_t)num_words * sizeof(uint32_t);
+        memcpy(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+        header->version = IMAGE_VERSION;
+        header->byte_order = IMAGE_BYTE_ORDER;
+        header->record_size = sizeof(Um_decoded);
+        header->num_words = (uint32_t)num_words;
+        header->words_offset = (sizeof(Image_header) + page_size - 1) /
+                               page_size * page_size;
+        header->decoded_offset = header->words_offset +
+                                 (segment_bytes + page_size - 1) /
+                                 page_size * page_size;
+        header->file_size = header->decoded_offset +
+                            (uint64_t)num_words * sizeof(Um_decoded);
+        header->source_size = (uint64_t)statistics.st_size;
+        header->source_mtime = (int64_t)statistics.st_mtim.tv_sec;
+        header->source_mtime_ns = (int64_t)statistics.st_mtim.tv_nsec;
+
+        /* Write to a temporary file so a failed write leaves any older
+         * image in place */
+        size_t path_length = strlen(image) + sizeof(".tmp");
+        char *temp_path = ALLOC(path_length);
+        snprintf(temp_path, path_length, "%s.tmp", image);
+        FILE *fp = fopen(temp_path, "wb");
+        if (fp == NULL) {
+                fprintf(stderr, "Error: Could not write image %s\n", image);
+                exit(EXIT_FAILURE);
+        }
+
+        /* The 0 segment is stored whole, marked as mapped storage */
+        uint64_t offset = 0;
+        Segment stored = { 1, header->num_words, header->num_words, 1 };
+        fwrite(header, sizeof(Image_header), 1, fp);
+        offset += sizeof(Image_header);
+        write_padding(fp, &offset, page_size);
+        fwrite(&stored, sizeof(Segment), 1, fp);
+        fwrite(program->words, sizeof(uint32_t), num_words, fp);
+        offset += segment_bytes;
+        write_padding(fp, &offset, page_size);
+        fwrite(decoded_program(space), sizeof(Um_decoded), num_words, fp);
+        offset += (uint64_t)num_words * sizeof(Um_decoded);
+
+        bool written = ferror(fp) == 0;
+        if (fclose(fp) != 0 || !written || offset != header->file_size ||
+            rename(temp_path, image) != 0) {
+                fprintf(stderr, "Error: Could not write image %s\n", image);
+                remove(temp_path);
+                exit(EXIT_FAILURE);
+        }
+        FREE(temp_path);
+        FREE(header);
+        free_all_segments(space);
+}
+
+/**************** is_image ****************
+ *
+ * Tells whether a file is a program image rather than a .um program.
+ *
+ * Parameters:
+ *      const char *path: the file
+ * Returns:
+ *      true if the file starts with the magic of an image
+ * Expects:
+ *      path is not NULL
+ *
+ ********************************************/
+extern bool is_image(const char *path)
+{
+        assert(path != NULL);
+        char magic[8] = { 0 };
+        FILE *fp = fopen(path, "rb");
+        if (fp == NULL) {
+                return false;
+        }
+        size_t num_read = fread(magic, 1, sizeof(magic), fp);
+        fclose(fp);
+        return num_read == sizeof(magic) &&
+               memcmp(magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) == 0;
+}
+
+/**************** load_image ****************
+ *
+ * Maps the 0 segment and its decoded records from an image into an empty
+ * address space. If the source the image was compiled from has changed
+ * since, a warning is printed and the source is read instead.
+ *
+ * Parameters:
+ *      const char *path:    the image
+ *      Address_space space: an address space with no segments mapped
+ * Returns:
+ *      the number of instructions in the 0 segment
+ * Expects:
+ *      path names an image written on a host of the same byte order by
+ *      this version of um, exits with an error message if not.
+ * Notes:
+ *      Both mappings are private, so the program may write to its 0
+ *      segment without changing the image, and the image may be replaced
+ *      or removed once this returns. A source that no longer exists does
+ *      not make the image stale.
+ *
+ ********************************************/
+extern size_t load_image(const char *path, Address_space space)
+{
+        assert(path != NULL && space != NULL);
+
+        /* Check the header and that both parts lie inside the file */
+        Image_header *header = ALLOC(sizeof(Image_header));
+        struct stat statistics;
+        int fd = open(path, O_RDONLY);
+        if (fd < 0 || fstat(fd, &statistics) != 0 ||
+            pread(fd, header, sizeof(Image_header), 0) !=
+            (ssize_t)sizeof(Image_header)) {
+                bad_image(path);
+        }
+        uint32_t num_words = header->num_words;
+        uint64_t segment_bytes = sizeof(Segment) +
+                                 (uint64_t)num_words * sizeof(uint32_t);
+        uint64_t decoded_bytes = (uint64_t)num_words * sizeof(Um_decoded);
+        if (memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+            header->version != IMAGE_VERSION ||
+            header->byte_order != IMAGE_BYTE_ORDER ||
+            header->record_size != sizeof(Um_decoded) ||
+            header->file_size != (uint64_t)statistics.st_size ||
+            header->words_offset < sizeof(Image_header) ||
+            header->decoded_offset < header->words_offset + segment_bytes ||
+            header->decoded_offset + decoded_bytes != header->file_size ||
+            memchr(header->source_path, '\0', IMAGE_PATH_LENGTH) == NULL) {
+                bad_image(path);
+        }
+
+        /* An image of an edited program must not run in its place */
+        if (is_stale(header)) {
+                fprintf(stderr, "Warning: %s is stale, running %s instead\n",
+                        path, header->source_path);
+                size_t num_inst = load_source(header->source_path, space);
+                FREE(header);
+                close(fd);
+                return num_inst;
+        }
+
+        /* Map the 0 segment, or read it if the image cannot be mapped */
+        Segment *program = map_file_segment(fd, header->words_offset,
+                                            num_words);
+        if (program == NULL) {
+                program = allocate_segment(space, num_words);
+                if (pread(fd, program->words, segment_bytes - sizeof(Segment),
+                          (off_t)(header->words_offset + sizeof(Segment))) !=
+                    (ssize_t)(segment_bytes - sizeof(Segment))) {
+                        bad_image(path);
+                }
+        }
+        install_segments(space, &program, 1, NULL, 0);
+
+        /* Map the decoded records too, or decode the words if they cannot
+         * be mapped */
+        Um_decoded *decoded = MAP_FAILED;
+        if (num_words > 0 &&
+            header->decoded_offset % (uint64_t)sysconf(_SC_PAGESIZE) == 0) {
+                decoded = mmap(NULL, decoded_bytes, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE, fd,
+                               (off_t)header->decoded_offset);
+        }
+        if (decoded != MAP_FAILED) {
+                install_decoded(space, decoded, (int)num_words);
+        } else {
+                decode_program(space);
+        }
+
+        FREE(header);
+        close(fd);
+        return num_words;
+}
+
+/**************** checksum_file ****************
+ *
+ * Computes the FNV-1a hash of the bytes of a file.
+ *
+ * Parameters:
+ *      const char *path:   the file
+ *      uint64_t *checksum: set to the hash
+ * Returns:
+ *      true if the whole file was read
+ *
+ ********************************************/
+static bool checksum_file(const char *path, uint64_t *checksum)
+{
+        FILE *fp = fopen(path, "rb");
+        if (fp == NULL) {
+                return false;
+        }
+        unsigned char chunk[65536];
+        uint64_t hash = FNV_OFFSET;
+        size_t num_read;
+        while ((num_read = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+                for (size_t i = 0; i < num_read; i++) {
+                        hash = (hash ^ chunk[i]) * FNV_PRIME;
+                }
+        }
+        bool complete = ferror(fp) == 0;
+        fclose(fp);
+        *checksum = hash;
+        return complete;
+}
+
+/**************** is_stale ****************
+ *
+ * Tells whether the source of an image has changed since it was compiled.
+ * The source is only hashed again when its size or modification time
+ * differ, so loading a fresh image never reads the source.
+ *
+ ********************************************/
+static bool is_stale(const Image_header *header)
+{
+        struct stat statistics;
+        if (stat(header->source_path, &statistics) != 0) {
+                return false;
+        }
+        if ((uint64_t)statistics.st_size == header->source_size &&
+            (int64_t)statistics.st_mtim.tv_sec == header->source_mtime &&
+            (int64_t)statistics.st_mtim.tv_nsec == header->source_mtime_ns) {
+                return false;
+        }
+        uint64_t checksum;
+        return (uint64_t)statistics.st_size != header->source_size ||
+               !checksum_file(header->source_path, &checksum) ||
+               checksum != header->source_checksum;
+}
+
+/**************** load_source ****************
+ *
+ * Reads and decodes a .um program into the 0 segment of an empty address
+ * space, exiting with an error message if it cannot be read.
+ *
+ ********************************************/
+static size_t load_source(const char *path, Address_space space)
+{
+        struct stat statistics;
+        FILE *fp = fopen(path, "rb");
+        if (fp == NULL || fstat(fileno(fp), &statistics) != 0 ||
+            statistics.st_size % 4 != 0) {
+                fprintf(stderr, "Error: Could not read program %s\n", path);
+                exit(EXIT_FAILURE);
+        }
+        size_t num_inst = (size_t)statistics.st_size / 4;
+        read_instructions(fp, space, num_inst);
+        return num_inst;
+}
+
+/**************** write_padding ****************
+ *
+ * Writes zero bytes up to the next multiple of alignment, advancing the
+ * offset of the stream to match.
+ *
+ ********************************************/
+static void write_padding(FILE *fp, uint64_t *offset, uint64_t alignment)
+{
+        while (*offset % alignment != 0) {
+                fputc(0, fp);
+                (*offset)++;
+        }
+}
+
+/**************** bad_image ****************
+ *
+ * Prints an error about the given image and exits with a failure status.
+ *
+ ********************************************/
+static void bad_image(const char *path)
+{
+        fprintf(stderr, "Error: %s is not a program image um can load\n",
+                path);
+        exit(EXIT_FAILURE);
+}
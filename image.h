@@ -0,0 +1,32 @@
+/**************************************************************
+ *
+ *                     image.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Declarations for program images (.umc files). An image holds
+ *              a program's words in host byte order together with their
+ *              decoded instructions, so that um can map it and start
+ *              executing without converting or decoding a word, and
+ *              remembers the .um file it was compiled from so that a stale
+ *              image is noticed.
+ * 
+ **************************************************************/
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "segment.h"
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern void compile_image(const char *source, const char *image);
+extern bool is_image(const char *path);
+extern size_t load_image(const char *path, Address_space space);
+
+#endif
@@ -0,0 +1,311 @@
+/**************************************************************
+ *
+ *                     input_buffer.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of the Input_buffer ADT. If the file
+ *              descriptor is a regular file, the rest of the file is mapped
+ *              into memory when the buffer is created and input is read
+ *              straight from the mapping. Otherwise (pipes, terminals,
+ *              sockets) the buffer is refilled with one read(2) of up to
+ *              64 KB whenever it runs out. A non-blocking descriptor with
+ *              nothing to read leaves the buffer empty but not at its end.
+ * 
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "input_buffer.h"
+#include "mem.h"
+#include "assert.h"
+
+/* Largest number of characters read from the descriptor at once */
+#define INPUT_BLOCK 65536
+
+/********** Input_buffer ********
+ * 
+ * Struct to hold the characters read ahead of the program, which are the
+ * bytes from next up to end. They are either in block or, for a regular
+ * file, in the mapping of the file. A buffer with a reader calls it for
+ * each character instead of reading fd.
+ *
+ *******************/
+struct Input_buffer {
+        int fd;                           /* where the input is read from */
+        Input_reader read;                /* callback read instead of fd,
+                                           * or NULL */
+        void *cl;                         /* passed to read */
+        const unsigned char *next;        /* next character to hand out */
+        const unsigned char *end;         /* end of the characters read */
+        void *mapping;                    /* mapping of a regular file */
+        size_t mapping_size;              /* number of bytes mapped */
+        bool at_eof;                      /* whether fd has no more input */
+        uint64_t consumed;                /* characters handed out so far */
+        unsigned char block[INPUT_BLOCK]; /* characters read with read(2) */
+};
+
+/* Declaration for the helper that reads the next block of input */
+static void refill(Input_buffer in);
+
+/**************** new_input_buffer ****************
+ * 
+ * Creates a new input buffer that reads from the given file descriptor,
+ * mapping the rest of the file into memory if it is a regular file.
+ *
+ * Parameters:
+ *      int fd: the file descriptor the input is read from
+ * Returns:
+ *      the new Input_buffer
+ * Expects:
+ *      The client frees the buffer with free_input_buffer.
+ *
+ ********************************************/
+extern Input_buffer new_input_buffer(int fd)
+{
+        Input_buffer in;
+        NEW(in);
+        in->fd = fd;
+        in->read = NULL;
+        in->cl = NULL;
+        in->next = in->block;
+        in->end = in->block;
+        in->mapping = NULL;
+        in->mapping_size = 0;
+        in->at_eof = false;
+        in->consumed = 0;
+
+        /* Map a regular file from the start, since mmap offsets must be
+         * page aligned, and begin at the descriptor's current offset */
+        struct stat info;
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && offset >= 0 &&
+            info.st_size > offset) {
+                void *mapping = mmap(NULL, (size_t)info.st_size, PROT_READ,
+                                     MAP_PRIVATE, fd, 0);
+                if (mapping != MAP_FAILED) {
+                        madvise(mapping, (size_t)info.st_size,
+                                MADV_SEQUENTIAL);
+                        in->mapping = mapping;
+                        in->mapping_size = (size_t)info.st_size;
+                        in->next = (unsigned char *)mapping + offset;
+                        in->end = (unsigned char *)mapping + info.st_size;
+                        in->at_eof = true;
+                }
+        }
+        return in;
+}
+
+/**************** new_input_reader ****************
+ * 
+ * Creates a new input buffer that gets its characters from the given
+ * callback, one each time the buffer runs out.
+ *
+ * Parameters:
+ *      Input_reader read: the callback the input comes from
+ *      void *cl:          passed to every call of read
+ * Returns:
+ *      the new Input_buffer
+ * Expects:
+ *      read is not NULL. The client frees the buffer with
+ *      free_input_buffer. input_ready returns false while read returns
+ *      INPUT_NOT_READY, and input_fd returns -1.
+ *
+ ********************************************/
+extern Input_buffer new_input_reader(Input_reader read, void *cl)
+{
+        assert(read != NULL);
+        Input_buffer in;
+        NEW(in);
+        in->fd = -1;
+        in->read = read;
+        in->cl = cl;
+        in->next = in->block;
+        in->end = in->block;
+        in->mapping = NULL;
+        in->mapping_size = 0;
+        in->at_eof = false;
+        in->consumed = 0;
+        return in;
+}
+
+/**************** get_input ****************
+ * 
+ * Returns the next character of input, reading another block if none is
+ * waiting.
+ *
+ * Parameters:
+ *      Input_buffer in: the buffer to read from
+ * Returns:
+ *      the next character as an unsigned char converted to an int, or EOF
+ *      if there is no more input.
+ * Expects:
+ *      in is not NULL. If the file descriptor is non-blocking, input_ready
+ *      has returned true since the last character was handed out.
+ *
+ ********************************************/
+extern int get_input(Input_buffer in)
+{
+        if (in->next == in->end) {
+                refill(in);
+                if (in->next == in->end) {
+                        return EOF;
+                }
+        }
+        in->consumed++;
+        return *in->next++;
+}
+
+/**************** input_pending ****************
+ * 
+ * Returns how many characters can be handed out without reading from the
+ * file descriptor, which is 0 when the next get_input may block.
+ *
+ * Parameters:
+ *      Input_buffer in: the buffer to check
+ * Returns:
+ *      the number of characters waiting
+ * Expects:
+ *      in is not NULL.
+ *
+ ********************************************/
+extern size_t input_pending(Input_buffer in)
+{
+        return (size_t)(in->end - in->next);
+}
+
+/**************** input_ready ****************
+ * 
+ * Returns whether get_input can return without waiting, reading the next
+ * block of input if none is waiting.
+ *
+ * Parameters:
+ *      Input_buffer in: the buffer to check
+ * Returns:
+ *      true if a character is waiting or the input has ended, false if
+ *      the file descriptor has nothing to read yet
+ * Expects:
+ *      in is not NULL. The file descriptor is non-blocking, or this waits
+ *      for input as get_input does.
+ *
+ ********************************************/
+extern bool input_ready(Input_buffer in)
+{
+        if (in->next == in->end && !in->at_eof) {
+                refill(in);
+        }
+        return in->next != in->end || in->at_eof;
+}
+
+/**************** input_fd ****************
+ * 
+ * Returns the file descriptor the buffer reads from, for clients that wait
+ * for input to arrive on it.
+ *
+ * Parameters:
+ *      Input_buffer in: the buffer to report on
+ * Returns:
+ *      the file descriptor, or -1 if the buffer has a reader
+ * Expects:
+ *      in is not NULL.
+ *
+ ********************************************/
+extern int input_fd(Input_buffer in)
+{
+        return in->fd;
+}
+
+/**************** input_consumed ****************
+ * 
+ * Returns how many characters the program has read from the buffer.
+ *
+ * Parameters:
+ *      Input_buffer in: the buffer to report on
+ * Returns:
+ *      the number of characters handed out by get_input
+ * Expects:
+ *      in is not NULL.
+ *
+ ********************************************/
+extern uint64_t input_consumed(Input_buffer in)
+{
+        return in->consumed;
+}
+
+/**************** free_input_buffer ****************
+ * 
+ * Frees the given input buffer, unmapping its file if it mapped one, and
+ * sets the client's pointer to NULL. The file descriptor is not closed.
+ *
+ * Parameters:
+ *      Input_buffer *in: pointer to the buffer to free
+ * Returns:
+ *      None
+ * Expects:
+ *      in and *in are not NULL.
+ *
+ ********************************************/
+extern void free_input_buffer(Input_buffer *in)
+{
+        assert(in != NULL && *in != NULL);
+        if ((*in)->mapping != NULL) {
+                munmap((*in)->mapping, (*in)->mapping_size);
+        }
+        FREE(*in);
+}
+
+/**************** refill ****************
+ * 
+ * Reads the next block of input into the buffer with a single read(2),
+ * which returns as soon as any input is available, or gets the next
+ * character from the buffer's reader.
+ *
+ * Parameters:
+ *      Input_buffer in: the buffer to refill
+ * Returns:
+ *      None. If no input could be read, the buffer is left empty and marked
+ *      as at end of file, unless the descriptor is non-blocking or the
+ *      reader has no input yet.
+ * Expects:
+ *      in is not NULL and has no characters waiting.
+ *
+ ********************************************/
+static void refill(Input_buffer in)
+{
+        if (in->at_eof) {
+                return;
+        }
+
+        /* A reader hands over one character at a time */
+        if (in->read != NULL) {
+                int c = in->read(in->cl);
+                if (c >= 0) {
+                        in->block[0] = (unsigned char)c;
+                }
+                in->at_eof = c < 0 && c != INPUT_NOT_READY;
+                in->next = in->block;
+                in->end = in->block + (c >= 0);
+                return;
+        }
+
+        ssize_t n;
+        do {
+                n = read(in->fd, in->block, INPUT_BLOCK);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                n = 0;
+        } else if (n <= 0) {
+                in->at_eof = true;
+                n = 0;
+        }
+        in->next = in->block;
+        in->end = in->block + n;
+}
@@ -0,0 +1,47 @@
+/**************************************************************
+ *
+ *                     input_buffer.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Function declarations for the Input_buffer ADT, which reads
+ *              the characters a UM program inputs from a file descriptor in
+ *              large blocks, or maps them all at once if the descriptor is a
+ *              regular file, or that asks a callback for them one at a
+ *              time.
+ * 
+ **************************************************************/
+
+#ifndef INPUT_BUFFER_H
+#define INPUT_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*****************************************************************
+ *                  Input_buffer Declaration
+ *****************************************************************/
+typedef struct Input_buffer *Input_buffer;
+
+/* Callback that an input buffer gets its characters from instead of a file
+ * descriptor. It returns the next character 0 - 255, EOF once there is no
+ * more input, or INPUT_NOT_READY if there is none yet */
+typedef int (*Input_reader)(void *cl);
+#define INPUT_NOT_READY (-2)
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern Input_buffer new_input_buffer(int fd);
+extern Input_buffer new_input_reader(Input_reader read, void *cl);
+extern int get_input(Input_buffer in);
+extern size_t input_pending(Input_buffer in);
+extern bool input_ready(Input_buffer in);
+extern int input_fd(Input_buffer in);
+extern uint64_t input_consumed(Input_buffer in);
+extern void free_input_buffer(Input_buffer *in);
+
+#endif
@@ -0,0 +1,785 @@
+/**************************************************************
+ *
+ *                     jit_execute.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of the tiered execution engine. Instructions
+ *              are first interpreted one basic block at a time, counting how
+ *              often each block is entered. Once a block has been entered
+ *              JIT_THRESHOLD times it is compiled into x86-64 code in which
+ *              the eight UM registers live in the host registers r8d - r15d.
+ *              Compiled blocks jump straight into each other on a LOADP of
+ *              segment 0, and return to the interpreter for any instruction
+ *              they do not handle (MAP, UNMAP, OUT, IN, HALT, a LOADP that
+ *              replaces segment 0, a store to segment 0, or any instruction
+ *              that would fail). All compiled code is thrown away when
+ *              segment 0 is replaced or a store changes an instruction that
+ *              was compiled.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include "jit_execute.h"
+#include "read_and_execute.h"
+#include "operations.h"
+#include "segment_private.h"
+#include "mem.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+/* Number of times a block is entered before it is compiled */
+#ifndef JIT_THRESHOLD
+#define JIT_THRESHOLD 32
+#endif
+
+/* Most instructions compiled into one block */
+#ifndef JIT_MAX_BLOCK
+#define JIT_MAX_BLOCK 256
+#endif
+
+/* Bytes of executable memory for compiled code */
+#ifndef JIT_CODE_SIZE
+#define JIT_CODE_SIZE (16 * 1024 * 1024)
+#endif
+
+/* Most bytes of code one instruction compiles to, counting its exit stub,
+ * and most checks one instruction can fail */
+#define JIT_INST_BYTES 128
+#define JIT_INST_CHECKS 5
+
+/* Set in the value a compiled block returns when the instruction at the
+ * returned program counter must be executed by the interpreter */
+#define JIT_INTERPRET ((uint64_t)1 << 32)
+
+/* Host registers used by compiled code. UM register i lives in r(8 + i) */
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RSI 6
+#define RDI 7
+#define UM_REG(i) (8 + (i))
+
+/* Condition codes for the jumps to exit stubs */
+#define CC_AE 0x3
+#define CC_E  0x4
+#define CC_NE 0x5
+
+/* Entry sequence of the compiled code, called with the registers, the
+ * address space, the table of compiled blocks and the block to run */
+typedef uint64_t (*Jit_entry)(uint32_t *regs, Address_space space,
+                              void **blocks, void *block);
+
+/********** Jit ********
+ *
+ * Struct to hold the compiled code for the current 0 segment and the counts
+ * used to decide what to compile. The tables are indexed by the program
+ * counter of the first instruction of a block.
+ *
+ *******************/
+typedef struct Jit {
+        unsigned char *code;    /* executable memory, or NULL if none */
+        size_t used;            /* bytes of code written so far */
+        size_t exit_offset;     /* offset of the shared exit sequence */
+        size_t blocks_offset;   /* offset at which compiled blocks start */
+        Jit_entry enter;        /* the shared entry sequence */
+        void **blocks;          /* compiled block at each pc, or NULL */
+        uint32_t *counts;       /* times the block at each pc was entered */
+        uint8_t *covered;       /* 1 for each pc inside a compiled block */
+        size_t length;          /* number of pcs the tables have room for */
+        size_t active;          /* number of pcs whose entries may be set */
+} *Jit;
+
+/********** Jit_check ********
+ *
+ * A conditional jump to the exit stub of the instruction at pc, whose 32-bit
+ * displacement at offset at is filled in once the stub is written.
+ *
+ *******************/
+typedef struct Jit_check {
+        size_t at;
+        uint32_t pc;
+} Jit_check;
+
+/* Declarations for the helpers that manage the compiled code */
+static Jit new_jit(size_t num_inst);
+static void free_jit(Jit *jit);
+static void reset_jit(Jit jit, size_t num_inst);
+static void flush_jit(Jit jit);
+static void *compile_block(Jit jit, Um_decoded *program, size_t start,
+                           size_t num_inst);
+static void emit_entry_and_exit(Jit jit);
+
+/*************** execute_jit ***************
+ *
+ * Executes the instructions which are contained in the 0 segment of the
+ * given machine, compiling the basic blocks that are entered often.
+ *
+ * Parameters:
+ *      Machine vm:      the machine whose address space holds the
+ *                       instructions in the 0 segment and whose registers
+ *                       they operate on.
+ *      size_t num_inst: number of instructions in the 0 segment
+ * Returns:
+ *      None.
+ * Expects:
+ *      The same as execute_instructions.
+ * Notes:
+ *      A basic block starts wherever the interpreter begins running code:
+ *      the start of the program, the target of a LOADP, and the instruction
+ *      after one that compiled code does not handle. If no executable memory
+ *      is available, every instruction is interpreted.
+ *
+ ********************************************/
+extern void execute_jit(Machine vm, size_t num_inst)
+{
+        Address_space space = vm->space;
+        uint32_t *registers = vm->registers;
+        Um_decoded *program = decoded_program(space);
+        Jit jit = new_jit(num_inst);
+
+        size_t prog_counter = vm->prog_counter;
+        while (prog_counter < num_inst) {
+                /* Compile the block at the program counter the time it
+                 * becomes hot */
+                void *block = jit->blocks[prog_counter];
+                if (block == NULL && jit->code != NULL &&
+                    jit->counts[prog_counter] < JIT_THRESHOLD &&
+                    ++jit->counts[prog_counter] == JIT_THRESHOLD) {
+                        block = compile_block(jit, program, prog_counter,
+                                              num_inst);
+                }
+
+                /* Run compiled code until it reaches an instruction it does
+                 * not handle, which is then interpreted on its own */
+                bool single = false;
+                if (block != NULL) {
+                        uint64_t next = jit->enter(registers, space,
+                                                   jit->blocks, block);
+                        prog_counter = (uint32_t)next;
+                        if ((next & JIT_INTERPRET) == 0) {
+                                continue;
+                        }
+                        single = true;
+                }
+
+                /* Interpret up to the end of the basic block */
+                bool block_ended = false;
+                while (!block_ended) {
+                        Um_decoded *instruction = &program[prog_counter];
+                        uint32_t a = instruction->a;
+                        uint32_t b = instruction->b;
+                        uint32_t c = instruction->c;
+                        prog_counter++;
+
+                        /* The interpreter does not run fused pairs */
+                        switch (instruction->op & OPCODE_MASK) {
+                        case CMOV:
+                                cmov(registers, a, b, c);
+                                break;
+                        case SLOAD:
+                                seg_load(space, registers, a, b, c);
+                                break;
+                        case SSTORE:
+                                {
+                                        uint32_t ID = registers[a];
+                                        uint32_t index = registers[b];
+                                        seg_store(space, registers, a, b, c);
+
+                                        /* Compiled code built from the
+                                         * old instruction is now stale */
+                                        if (ID == 0 && index < jit->active &&
+                                            jit->covered[index]) {
+                                                flush_jit(jit);
+                                        }
+                                }
+                                break;
+                        case ADD:
+                                add(registers, a, b, c);
+                                break;
+                        case MUL:
+                                multiply(registers, a, b, c);
+                                break;
+                        case DIV:
+                                divide(registers, a, b, c);
+                                break;
+                        case NAND:
+                                nand(registers, a, b, c);
+                                break;
+                        case HALT:
+                                free_jit(&jit);
+                                halt(vm);
+                                return;
+                        case MAP:
+                                map_segment(space, registers, b, c, 0, false);
+                                block_ended = true;
+                                break;
+                        case UNMAP:
+                                unmap_segment(space, registers, c);
+                                block_ended = true;
+                                break;
+                        case OUT:
+                                output(vm->out, registers, c);
+                                block_ended = true;
+                                break;
+                        case IN:
+                                input(vm->in, vm->out, registers, c);
+                                block_ended = true;
+                                break;
+                        case LOADP:
+                                {
+                                        /* Throw the compiled code away if
+                                         * the 0 segment is replaced */
+                                        Segment *old = space->segments[0];
+                                        load_program(space, registers, b, c,
+                                                     &prog_counter, &num_inst);
+                                        if (space->segments[0] != old) {
+                                                program =
+                                                    decoded_program(space);
+                                                reset_jit(jit, num_inst);
+                                        }
+                                }
+                                block_ended = true;
+                                break;
+                        case LV:
+                                load_value(registers, a, instruction->val);
+                                break;
+                        default:
+                                exit(EXIT_FAILURE);
+                        }
+
+                        /* Stop at the end of the 0 segment and at the start
+                         * of a compiled block */
+                        if (single || prog_counter >= num_inst ||
+                            jit->blocks[prog_counter] != NULL) {
+                                block_ended = true;
+                        }
+                }
+        }
+
+        free_jit(&jit);
+}
+
+/**************** new_jit ****************
+ *
+ * Creates the compiled code state for a 0 segment of the given length,
+ * mapping the executable memory and writing the entry and exit sequences.
+ *
+ * Parameters:
+ *      size_t num_inst: number of instructions in the 0 segment
+ * Returns:
+ *      the new Jit, whose code is NULL if no executable memory could be
+ *      mapped
+ * Expects:
+ *      The client frees the Jit with free_jit.
+ *
+ ********************************************/
+static Jit new_jit(size_t num_inst)
+{
+        Jit jit;
+        NEW(jit);
+        jit->used = 0;
+        jit->exit_offset = 0;
+        jit->blocks_offset = 0;
+        jit->length = 0;
+        jit->active = 0;
+        jit->blocks = NULL;
+        jit->counts = NULL;
+        jit->covered = NULL;
+
+        jit->code = mmap(NULL, JIT_CODE_SIZE,
+                         PROT_READ | PROT_WRITE | PROT_EXEC,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (jit->code == MAP_FAILED) {
+                jit->code = NULL;
+        } else {
+                emit_entry_and_exit(jit);
+        }
+
+        reset_jit(jit, num_inst);
+        return jit;
+}
+
+/**************** free_jit ****************
+ *
+ * Frees the compiled code and the tables, and sets the client's pointer to
+ * NULL.
+ *
+ * Parameters:
+ *      Jit *jit: pointer to the Jit to free
+ * Returns:
+ *      None
+ * Expects:
+ *      jit and *jit are not NULL.
+ *
+ ********************************************/
+static void free_jit(Jit *jit)
+{
+        assert(jit != NULL && *jit != NULL);
+        if ((*jit)->code != NULL) {
+                munmap((*jit)->code, JIT_CODE_SIZE);
+        }
+        FREE((*jit)->blocks);
+        FREE((*jit)->counts);
+        FREE((*jit)->covered);
+        FREE(*jit);
+}
+
+/**************** reset_jit ****************
+ *
+ * Throws away all the compiled code and counts and sizes the tables for a
+ * new 0 segment. The tables only grow, but only the entries of the old and
+ * the new 0 segment are cleared, so that a LOADP of a short segment after a
+ * long one costs as little as the short one.
+ *
+ * Parameters:
+ *      Jit jit:         the Jit to reset
+ *      size_t num_inst: number of instructions in the new 0 segment
+ * Returns:
+ *      None
+ * Expects:
+ *      jit is not NULL.
+ *
+ ********************************************/
+static void reset_jit(Jit jit, size_t num_inst)
+{
+        /* One spare entry lets the interpreter look at the table one past
+         * the last instruction */
+        if (num_inst + 1 > jit->length) {
+                FREE(jit->blocks);
+                FREE(jit->counts);
+                FREE(jit->covered);
+                jit->length = num_inst + 1;
+                jit->blocks = CALLOC(jit->length, sizeof(*jit->blocks));
+                jit->counts = CALLOC(jit->length, sizeof(*jit->counts));
+                jit->covered = CALLOC(jit->length, sizeof(*jit->covered));
+                jit->active = 0;
+        }
+        flush_jit(jit);
+        jit->active = num_inst + 1;
+}
+
+/**************** flush_jit ****************
+ *
+ * Throws away all the compiled code and counts, keeping the entry and exit
+ * sequences. Only the entries of the current 0 segment can have been set, so
+ * only those are cleared.
+ *
+ * Parameters:
+ *      Jit jit: the Jit to flush
+ * Returns:
+ *      None
+ * Expects:
+ *      jit is not NULL and no compiled code is running.
+ *
+ ********************************************/
+static void flush_jit(Jit jit)
+{
+        memset(jit->blocks, 0, jit->active * sizeof(*jit->blocks));
+        memset(jit->counts, 0, jit->active * sizeof(*jit->counts));
+        memset(jit->covered, 0, jit->active * sizeof(*jit->covered));
+        jit->used = jit->blocks_offset;
+}
+
+/*****************************************************************
+ *                  x86-64 Code Emission
+ *****************************************************************/
+
+/* Appends one byte of code */
+static inline void emit_byte(Jit jit, uint8_t byte)
+{
+        jit->code[jit->used++] = byte;
+}
+
+/* Appends a 32-bit little-endian value */
+static inline void emit_u32(Jit jit, uint32_t value)
+{
+        memcpy(&jit->code[jit->used], &value, sizeof(value));
+        jit->used += sizeof(value);
+}
+
+/* Appends the REX prefix needed by the given registers, if any */
+static void emit_rex(Jit jit, bool wide, int reg, int index, int base)
+{
+        uint8_t rex = 0x40 | (wide << 3) | ((reg >> 3) << 2) |
+                      ((index >> 3) << 1) | (base >> 3);
+        if (rex != 0x40) {
+                emit_byte(jit, rex);
+        }
+}
+
+/* Appends a one byte opcode, or a two byte opcode starting with 0x0F */
+static void emit_opcode(Jit jit, uint32_t opcode)
+{
+        if (opcode > 0xFF) {
+                emit_byte(jit, opcode >> 8);
+        }
+        emit_byte(jit, opcode & 0xFF);
+}
+
+/* Appends an instruction whose operands are the registers reg and rm */
+static void emit_rr(Jit jit, bool wide, uint32_t opcode, int reg, int rm)
+{
+        emit_rex(jit, wide, reg, 0, rm);
+        emit_opcode(jit, opcode);
+        emit_byte(jit, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+/* Appends an instruction whose operands are the register reg and the memory
+ * at base + disp, or at base + (index << scale) + disp if index is not -1 */
+static void emit_mem(Jit jit, bool wide, uint32_t opcode, int reg, int base,
+                     int index, int scale, size_t disp)
+{
+        emit_rex(jit, wide, reg, index < 0 ? 0 : index, base);
+        emit_opcode(jit, opcode);
+        if (index < 0) {
+                emit_byte(jit, 0x80 | ((reg & 7) << 3) | (base & 7));
+        } else {
+                emit_byte(jit, 0x80 | ((reg & 7) << 3) | 4);
+                emit_byte(jit, (scale << 6) | ((index & 7) << 3) |
+                               (base & 7));
+        }
+        emit_u32(jit, (uint32_t)disp);
+}
+
+/* Appends a jump (or, if cc is not -1, a conditional jump) to the code at
+ * the given offset */
+static void emit_jump(Jit jit, int cc, size_t target)
+{
+        if (cc < 0) {
+                emit_byte(jit, 0xE9);
+        } else {
+                emit_byte(jit, 0x0F);
+                emit_byte(jit, 0x80 | cc);
+        }
+        emit_u32(jit, (uint32_t)(target - (jit->used + 4)));
+}
+
+/* Appends a return to the interpreter at the given program counter, which
+ * is asked to interpret that instruction if interpret is true */
+static void emit_return(Jit jit, uint32_t pc, bool interpret)
+{
+        if (interpret) {
+                /* mov rax, imm64 */
+                uint64_t value = JIT_INTERPRET | pc;
+                emit_byte(jit, 0x48);
+                emit_byte(jit, 0xB8);
+                emit_u32(jit, (uint32_t)value);
+                emit_u32(jit, (uint32_t)(value >> 32));
+        } else {
+                /* mov eax, imm32 */
+                emit_byte(jit, 0xB8);
+                emit_u32(jit, pc);
+        }
+        emit_jump(jit, -1, jit->exit_offset);
+}
+
+/* Appends a conditional jump to the exit stub of the instruction at pc,
+ * recording it in checks so the stub can be written after the block */
+static void emit_check(Jit jit, int cc, Jit_check *checks, int *num_checks,
+                       uint32_t pc)
+{
+        emit_byte(jit, 0x0F);
+        emit_byte(jit, 0x80 | cc);
+        checks[*num_checks].at = jit->used;
+        checks[*num_checks].pc = pc;
+        (*num_checks)++;
+        emit_u32(jit, 0);
+}
+
+/**************** emit_entry_and_exit ****************
+ *
+ * Writes the sequences shared by all compiled blocks at the start of the
+ * code: the entry, which saves the callee-saved host registers, loads the UM
+ * registers into r8d - r15d and jumps to a block, and the exit, which stores
+ * the UM registers back and returns the value left in rax.
+ *
+ * Parameters:
+ *      Jit jit: the Jit whose code is written
+ * Returns:
+ *      None
+ * Expects:
+ *      jit->code is empty.
+ * Notes:
+ *      While compiled code runs, rdi holds the registers, rsi the address
+ *      space and rbx the table of compiled blocks.
+ *
+ ********************************************/
+static void emit_entry_and_exit(Jit jit)
+{
+        void *entry = jit->code;
+        memcpy(&jit->enter, &entry, sizeof(entry));
+
+        /* push rbx, r12 - r15 */
+        emit_byte(jit, 0x53);
+        for (int reg = 12; reg <= 15; reg++) {
+                emit_byte(jit, 0x41);
+                emit_byte(jit, 0x50 | (reg & 7));
+        }
+
+        /* mov rbx, rdx */
+        emit_rr(jit, true, 0x89, RDX, RBX);
+
+        /* mov r(8 + i)d, [rdi + 4i] */
+        for (int i = 0; i < NUM_REGISTERS; i++) {
+                emit_mem(jit, false, 0x8B, UM_REG(i), RDI, -1, 0,
+                         i * sizeof(uint32_t));
+        }
+
+        /* jmp rcx */
+        emit_rr(jit, false, 0xFF, 4, RCX);
+
+        /* mov [rdi + 4i], r(8 + i)d */
+        jit->exit_offset = jit->used;
+        for (int i = 0; i < NUM_REGISTERS; i++) {
+                emit_mem(jit, false, 0x89, UM_REG(i), RDI, -1, 0,
+                         i * sizeof(uint32_t));
+        }
+
+        /* pop r15 - r12, rbx; ret */
+        for (int reg = 15; reg >= 12; reg--) {
+                emit_byte(jit, 0x41);
+                emit_byte(jit, 0x58 | (reg & 7));
+        }
+        emit_byte(jit, 0x5B);
+        emit_byte(jit, 0xC3);
+
+        jit->blocks_offset = jit->used;
+}
+
+/**************** emit_segment ****************
+ *
+ * Appends code that leaves in rcx the segment whose ID is in eax, jumping
+ * to the exit stub of the instruction at pc if it is not mapped.
+ *
+ ********************************************/
+static void emit_segment(Jit jit, Jit_check *checks, int *num_checks,
+                         uint32_t pc)
+{
+        /* cmp eax, [rsi + num_segments]; jae exit */
+        emit_mem(jit, false, 0x3B, RAX, RSI, -1, 0,
+                 offsetof(struct Address_space, num_segments));
+        emit_check(jit, CC_AE, checks, num_checks, pc);
+
+        /* mov rcx, [rsi + segments]; mov rcx, [rcx + rax * 8] */
+        emit_mem(jit, true, 0x8B, RCX, RSI, -1, 0,
+                 offsetof(struct Address_space, segments));
+        emit_mem(jit, true, 0x8B, RCX, RCX, RAX, 3, 0);
+
+        /* test rcx, rcx; je exit */
+        emit_rr(jit, true, 0x85, RCX, RCX);
+        emit_check(jit, CC_E, checks, num_checks, pc);
+}
+
+/**************** compile_block ****************
+ *
+ * Compiles the basic block starting at the given program counter.
+ *
+ * Parameters:
+ *      Jit jit:             the Jit to add the block to
+ *      Um_decoded *program: the decoded 0 segment
+ *      size_t start:        program counter of the first instruction
+ *      size_t num_inst:     number of instructions in the 0 segment
+ * Returns:
+ *      the compiled block, or NULL if the first instruction is not one that
+ *      compiled code handles
+ * Expects:
+ *      jit->code is not NULL and start < num_inst.
+ * Notes:
+ *      The block ends at a LOADP, at an instruction compiled code does not
+ *      handle, at the end of the 0 segment, or after JIT_MAX_BLOCK
+ *      instructions. Every check a compiled instruction makes (an unmapped
+ *      segment, an index out of bounds, a shared segment, a store to segment
+ *      0, division by 0) jumps to a stub that returns to the interpreter
+ *      before the instruction has any effect, so the interpreter executes
+ *      it, or fails, exactly as the other engines do.
+ *
+ ********************************************/
+static void *compile_block(Jit jit, Um_decoded *program, size_t start,
+                           size_t num_inst)
+{
+        uint8_t first = program[start].op & OPCODE_MASK;
+        if (first == HALT || first == MAP || first == UNMAP || first == OUT ||
+            first == IN || first > LV) {
+                return NULL;
+        }
+
+        /* Start over once the code memory is nearly full */
+        if (JIT_CODE_SIZE - jit->used < JIT_MAX_BLOCK * JIT_INST_BYTES) {
+                flush_jit(jit);
+        }
+
+        size_t block = jit->used;
+        Jit_check checks[JIT_MAX_BLOCK * JIT_INST_CHECKS];
+        int num_checks = 0;
+        bool ended = false;
+        size_t pc = start;
+
+        while (!ended) {
+                if (pc >= num_inst || pc - start >= JIT_MAX_BLOCK) {
+                        emit_return(jit, pc, false);
+                        break;
+                }
+
+                Um_decoded *in = &program[pc];
+                int a = UM_REG(in->a);
+                int b = UM_REG(in->b);
+                int c = UM_REG(in->c);
+                jit->covered[pc] = 1;
+
+                switch (in->op & OPCODE_MASK) {
+                case CMOV:
+                        /* test rC, rC; cmovne rA, rB */
+                        emit_rr(jit, false, 0x85, c, c);
+                        emit_rr(jit, false, 0x0F45, a, b);
+                        break;
+
+                case SLOAD:
+                        /* mov eax, rB; rcx = segment */
+                        emit_rr(jit, false, 0x89, b, RAX);
+                        emit_segment(jit, checks, &num_checks, pc);
+
+                        /* mov eax, rC; cmp eax, [rcx + length]; jae exit */
+                        emit_rr(jit, false, 0x89, c, RAX);
+                        emit_mem(jit, false, 0x3B, RAX, RCX, -1, 0,
+                                 offsetof(Segment, length));
+                        emit_check(jit, CC_AE, checks, &num_checks, pc);
+
+                        /* mov rA, [rcx + rax * 4 + words] */
+                        emit_mem(jit, false, 0x8B, a, RCX, RAX, 2,
+                                 offsetof(Segment, words));
+                        break;
+
+                case SSTORE:
+                        /* mov eax, rA; test eax, eax; je exit */
+                        emit_rr(jit, false, 0x89, a, RAX);
+                        emit_rr(jit, false, 0x85, RAX, RAX);
+                        emit_check(jit, CC_E, checks, &num_checks, pc);
+                        emit_segment(jit, checks, &num_checks, pc);
+
+                        /* cmp dword [rcx + refs], 1; jne exit */
+                        emit_mem(jit, false, 0x83, 7, RCX, -1, 0,
+                                 offsetof(Segment, refs));
+                        emit_byte(jit, 1);
+                        emit_check(jit, CC_NE, checks, &num_checks, pc);
+
+                        /* mov eax, rB; cmp eax, [rcx + length]; jae exit */
+                        emit_rr(jit, false, 0x89, b, RAX);
+                        emit_mem(jit, false, 0x3B, RAX, RCX, -1, 0,
+                                 offsetof(Segment, length));
+                        emit_check(jit, CC_AE, checks, &num_checks, pc);
+
+                        /* mov [rcx + rax * 4 + words], rC */
+                        emit_mem(jit, false, 0x89, c, RCX, RAX, 2,
+                                 offsetof(Segment, words));
+                        break;
+
+                case ADD:
+                        /* mov eax, rB; add eax, rC; mov rA, eax */
+                        emit_rr(jit, false, 0x89, b, RAX);
+                        emit_rr(jit, false, 0x01, c, RAX);
+                        emit_rr(jit, false, 0x89, RAX, a);
+                        break;
+
+                case MUL:
+                        /* mov eax, rB; imul eax, rC; mov rA, eax */
+                        emit_rr(jit, false, 0x89, b, RAX);
+                        emit_rr(jit, false, 0x0FAF, RAX, c);
+                        emit_rr(jit, false, 0x89, RAX, a);
+                        break;
+
+                case DIV:
+                        /* test rC, rC; je exit */
+                        emit_rr(jit, false, 0x85, c, c);
+                        emit_check(jit, CC_E, checks, &num_checks, pc);
+
+                        /* mov eax, rB; xor edx, edx; div rC; mov rA, eax */
+                        emit_rr(jit, false, 0x89, b, RAX);
+                        emit_rr(jit, false, 0x31, RDX, RDX);
+                        emit_rr(jit, false, 0xF7, 6, c);
+                        emit_rr(jit, false, 0x89, RAX, a);
+                        break;
+
+                case NAND:
+                        /* mov eax, rB; and eax, rC; not eax; mov rA, eax */
+                        emit_rr(jit, false, 0x89, b, RAX);
+                        emit_rr(jit, false, 0x21, c, RAX);
+                        emit_rr(jit, false, 0xF7, 2, RAX);
+                        emit_rr(jit, false, 0x89, RAX, a);
+                        break;
+
+                case LOADP:
+                        /* test rB, rB; jne exit */
+                        emit_rr(jit, false, 0x85, b, b);
+                        emit_check(jit, CC_NE, checks, &num_checks, pc);
+
+                        /* mov eax, rC; leave if past the 0 segment */
+                        emit_rr(jit, false, 0x89, c, RAX);
+                        emit_byte(jit, 0x3D);
+                        emit_u32(jit, (uint32_t)num_inst);
+                        emit_jump(jit, CC_AE, jit->exit_offset);
+
+                        /* mov rdx, [rbx + rax * 8]; test rdx, rdx; leave if
+                         * the target is not compiled, else jmp rdx */
+                        emit_mem(jit, true, 0x8B, RDX, RBX, RAX, 3, 0);
+                        emit_rr(jit, true, 0x85, RDX, RDX);
+                        emit_jump(jit, CC_E, jit->exit_offset);
+                        emit_rr(jit, false, 0xFF, 4, RDX);
+                        ended = true;
+                        break;
+
+                case LV:
+                        /* mov rA, imm32 */
+                        emit_rex(jit, false, 0, 0, a);
+                        emit_byte(jit, 0xB8 | (a & 7));
+                        emit_u32(jit, in->val);
+                        break;
+
+                default:
+                        /* Everything else is left to the interpreter */
+                        jit->covered[pc] = 0;
+                        emit_return(jit, pc, true);
+                        ended = true;
+                        break;
+                }
+                pc++;
+        }
+
+        /* Write one exit stub per instruction with checks and point its
+         * checks at it */
+        size_t stub = 0;
+        for (int i = 0; i < num_checks; i++) {
+                if (i == 0 || checks[i].pc != checks[i - 1].pc) {
+                        stub = jit->used;
+                        emit_return(jit, checks[i].pc, true);
+                }
+                uint32_t disp = (uint32_t)(stub - (checks[i].at + 4));
+                memcpy(&jit->code[checks[i].at], &disp, sizeof(disp));
+        }
+
+        jit->blocks[start] = &jit->code[block];
+        return jit->blocks[start];
+}
+
+#else
+
+/*************** execute_jit ***************
+ *
+ * Hosts other than x86-64 interpret every instruction.
+ *
+ ********************************************/
+extern void execute_jit(Machine vm, size_t num_inst)
+{
+        execute_instructions(vm, num_inst);
+}
+
+#endif
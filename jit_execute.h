@@ -0,0 +1,27 @@
+/**************************************************************
+ *
+ *                     jit_execute.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Function declaration for the tiered execution engine, which
+ *              interprets the instructions in the 0 segment and compiles the
+ *              basic blocks that run often into native x86-64 code.
+ *
+ **************************************************************/
+
+#ifndef JIT_EXECUTE_H
+#define JIT_EXECUTE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "machine.h"
+
+/*****************************************************************
+ *                  Program Function Declarations
+ *****************************************************************/
+extern void execute_jit(Machine vm, size_t num_inst);
+
+#endif
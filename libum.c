@@ -0,0 +1,305 @@
+/**************************************************************
+ *
+ *                     libum.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of libum. Each machine is a Machine, run by
+ *              the budgeted variant of the threaded engine, which stops
+ *              after exactly the number of instructions the host asks for,
+ *              at an input instruction with no input yet, or at an
+ *              instruction that fails. Its input buffer gets characters from
+ *              the host's read callback and its output buffer hands them to
+ *              the host's write callback when the block fills, before each
+ *              read, and whenever um_run returns.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "libum.h"
+#include "machine.h"
+#include "threaded_execute.h"
+#include "segment_private.h"
+#include "load_words.h"
+#include "mem.h"
+#include "assert.h"
+
+/********** Um_vm ********
+ *
+ * Struct to hold everything about one machine, so that machines share
+ * nothing.
+ *
+ *******************/
+struct Um_vm {
+        Machine machine;  /* registers, segments and buffers of the machine */
+        Um_io io;         /* the host's callbacks */
+        Um_status status; /* set once halted or failed */
+        Um_error error;   /* why the machine failed */
+};
+
+/* Declarations for the helpers */
+static int read_input(void *cl);
+static Um_error error_of(Machine_failure failure);
+
+/**************** um_new ****************
+ *
+ * Creates a machine whose 0 segment holds the given program and whose
+ * registers are all 0.
+ *
+ * Parameters:
+ *      const unsigned char *program: the program as in a .um file, as
+ *                                    big-endian words
+ *      size_t num_bytes:             number of bytes in the program
+ *      Um_io io:                     the callbacks for input and output
+ * Returns:
+ *      the new machine, or NULL if num_bytes is not a multiple of 4
+ * Expects:
+ *      program is not NULL unless num_bytes is 0. The program is copied,
+ *      so the host may free it once this returns. The host frees the
+ *      machine with um_free.
+ *
+ ********************************************/
+extern Um_vm um_new(const unsigned char *program, size_t num_bytes,
+                    Um_io io)
+{
+        if (num_bytes % sizeof(uint32_t) != 0 ||
+            num_bytes / sizeof(uint32_t) > UINT32_MAX) {
+                return NULL;
+        }
+        assert(program != NULL || num_bytes == 0);
+
+        Um_vm vm;
+        NEW(vm);
+        vm->io = io;
+        vm->status = UM_RUNNING;
+        vm->error = UM_NO_ERROR;
+        vm->machine = new_machine_buffers(new_input_reader(read_input, vm),
+                                          new_output_writer(io.write,
+                                                            io.cl));
+
+        /* Convert the program into the 0 segment and decode it */
+        Address_space space = vm->machine->space;
+        size_t num_inst = num_bytes / sizeof(uint32_t);
+        map_segment(space, NULL, 0, 0, (int)num_inst, true);
+        if (num_inst > 0) {
+                load_big_endian(space->segments[0]->words, program, num_inst);
+        }
+        decode_program(space);
+        return vm;
+}
+
+/**************** um_run ****************
+ *
+ * Runs a machine until it has run the given number of instructions,
+ * halts, waits for input, or fails.
+ *
+ * Parameters:
+ *      Um_vm vm:                  the machine
+ *      uint64_t max_instructions: most instructions to run, or 0 for no
+ *                                 limit
+ * Returns:
+ *      UM_RUNNING if the budget ran out first, UM_HALTED, UM_BLOCKED if the
+ *      read callback had no input, or UM_FAILED, in which case um_error
+ *      says why
+ * Expects:
+ *      vm is not NULL.
+ * Notes:
+ *      A blocked machine is left at its input instruction and a failed one
+ *      at the instruction that failed. Once a machine has halted or failed,
+ *      um_run returns the same status again without running anything. All
+ *      the output is handed to the write callback before this returns.
+ *      Running out of memory for a new segment still raises Mem_Failed.
+ *
+ ********************************************/
+extern Um_status um_run(Um_vm vm, uint64_t max_instructions)
+{
+        assert(vm != NULL);
+        if (vm->status == UM_HALTED || vm->status == UM_FAILED) {
+                return vm->status;
+        }
+
+        /* Run one turn of the budget, which cannot count past the most
+         * instructions the machine can record */
+        Machine machine = vm->machine;
+        uint64_t left = UINT64_MAX - machine->instructions;
+        machine->quantum = max_instructions == 0 || max_instructions > left ?
+                           left : max_instructions;
+        assert(machine->quantum > 0);
+        execute_threaded_budgeted(machine, machine->space->segments[0]->length);
+        flush_output(machine->out);
+
+        /* A blocked machine can run again once the host has input */
+        Um_status status;
+        if (machine->state == MACHINE_READY) {
+                status = UM_RUNNING;
+        } else if (machine->state == MACHINE_STOPPED) {
+                status = machine->failure_code == FAILURE_NONE ? UM_HALTED :
+                                                                 UM_FAILED;
+        } else {
+                status = UM_BLOCKED;
+        }
+        if (status == UM_FAILED) {
+                vm->error = error_of(machine->failure_code);
+        }
+        vm->status = status == UM_BLOCKED ? UM_RUNNING : status;
+        return status;
+}
+
+/**************** um_step ****************
+ *
+ * Runs one instruction of a machine.
+ *
+ * Parameters:
+ *      Um_vm vm: the machine
+ * Returns:
+ *      the status, as from um_run
+ * Expects:
+ *      vm is not NULL.
+ *
+ ********************************************/
+extern Um_status um_step(Um_vm vm)
+{
+        return um_run(vm, 1);
+}
+
+/**************** um_error ****************
+ *
+ * Returns why a machine failed, or UM_NO_ERROR if it has not.
+ *
+ ********************************************/
+extern Um_error um_error(Um_vm vm)
+{
+        assert(vm != NULL);
+        return vm->error;
+}
+
+/**************** um_error_message ****************
+ *
+ * Returns a description of an error for the host to print.
+ *
+ ********************************************/
+extern const char *um_error_message(Um_error error)
+{
+        switch (error) {
+        case UM_NO_ERROR:
+                return "no error";
+        case UM_BAD_INSTRUCTION:
+                return failure_message(FAILURE_BAD_INSTRUCTION);
+        case UM_UNMAPPED_SEGMENT:
+                return failure_message(FAILURE_UNMAPPED_SEGMENT);
+        case UM_BAD_INDEX:
+                return failure_message(FAILURE_BAD_INDEX);
+        case UM_DIVIDE_BY_ZERO:
+                return failure_message(FAILURE_DIVIDE_BY_ZERO);
+        case UM_UNMAP_ZERO:
+                return failure_message(FAILURE_UNMAP_ZERO);
+        case UM_BAD_OUTPUT:
+                return failure_message(FAILURE_BAD_OUTPUT);
+        }
+        return "unknown error";
+}
+
+/**************** um_instructions ****************
+ *
+ * Returns the number of instructions a machine has run.
+ *
+ ********************************************/
+extern uint64_t um_instructions(Um_vm vm)
+{
+        assert(vm != NULL);
+        return vm->machine->instructions;
+}
+
+/**************** um_register ****************
+ *
+ * Returns the value in one register of a machine.
+ *
+ * Expects:
+ *      vm is not NULL and index is less than 8.
+ *
+ ********************************************/
+extern uint32_t um_register(Um_vm vm, unsigned index)
+{
+        assert(vm != NULL && index < NUM_REGISTERS);
+        return vm->machine->registers[index];
+}
+
+/**************** um_prog_counter ****************
+ *
+ * Returns the index in the 0 segment of the next instruction a machine
+ * will run.
+ *
+ ********************************************/
+extern uint32_t um_prog_counter(Um_vm vm)
+{
+        assert(vm != NULL);
+        return vm->machine->prog_counter;
+}
+
+/**************** um_free ****************
+ *
+ * Hands any output left to the write callback, frees a machine and all of
+ * its segments, and sets the host's pointer to NULL.
+ *
+ * Parameters:
+ *      Um_vm *vm: pointer to the machine to free
+ * Returns:
+ *      None
+ * Expects:
+ *      vm and *vm are not NULL.
+ *
+ ********************************************/
+extern void um_free(Um_vm *vm)
+{
+        assert(vm != NULL && *vm != NULL);
+        free_machine(&(*vm)->machine);
+        FREE(*vm);
+}
+
+/**************** read_input ****************
+ *
+ * Gets the next character of a machine's input from the host's read
+ * callback, first handing the output so far to the write callback so that
+ * a prompt is seen before the host is asked for input.
+ *
+ ********************************************/
+static int read_input(void *cl)
+{
+        Um_vm vm = cl;
+        flush_output(vm->machine->out);
+        int c = vm->io.read == NULL ? UM_EOF : vm->io.read(vm->io.cl);
+        if (c == UM_NO_INPUT) {
+                return INPUT_NOT_READY;
+        }
+        return c < 0 ? EOF : c;
+}
+
+/**************** error_of ****************
+ *
+ * Returns the error a host sees for the reason the engine gave for a
+ * machine failing.
+ *
+ ********************************************/
+static Um_error error_of(Machine_failure failure)
+{
+        switch (failure) {
+        case FAILURE_NONE:
+                return UM_NO_ERROR;
+        case FAILURE_BAD_INSTRUCTION:
+                return UM_BAD_INSTRUCTION;
+        case FAILURE_UNMAPPED_SEGMENT:
+                return UM_UNMAPPED_SEGMENT;
+        case FAILURE_BAD_INDEX:
+                return UM_BAD_INDEX;
+        case FAILURE_DIVIDE_BY_ZERO:
+                return UM_DIVIDE_BY_ZERO;
+        case FAILURE_UNMAP_ZERO:
+                return UM_UNMAP_ZERO;
+        case FAILURE_BAD_OUTPUT:
+                return UM_BAD_OUTPUT;
+        }
+        return UM_BAD_INSTRUCTION;
+}
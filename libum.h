@@ -0,0 +1,91 @@
+/**************************************************************
+ *
+ *                     libum.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Interface of libum, the Universal Machine as a library. A
+ *              host creates any number of machines from programs held in
+ *              memory, runs each for as many instructions as it likes, and
+ *              gets a status back instead of the process exiting: the
+ *              machine halted, is waiting for input, or failed and why.
+ *              Input and output go through callbacks the host supplies.
+ *              Machines share no state, so separate machines may run on
+ *              separate threads.
+ * 
+ **************************************************************/
+
+#ifndef LIBUM_H
+#define LIBUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*****************************************************************
+ *                  Um_vm Declaration
+ *****************************************************************/
+typedef struct Um_vm *Um_vm;
+
+/********** Um_status ********
+ * 
+ * What a machine is doing when um_run returns.
+ *
+ *******************/
+typedef enum Um_status {
+        UM_RUNNING = 0, /* ran the instructions asked for, more remain */
+        UM_HALTED,      /* halted, or ran off the end of the 0 segment */
+        UM_BLOCKED,     /* waiting at an input instruction for input */
+        UM_FAILED       /* stopped at an instruction that failed */
+} Um_status;
+
+/********** Um_error ********
+ * 
+ * Why a machine failed.
+ *
+ *******************/
+typedef enum Um_error {
+        UM_NO_ERROR = 0,
+        UM_BAD_INSTRUCTION,  /* opcode 14 or 15 */
+        UM_UNMAPPED_SEGMENT, /* access, unmap or LOADP of an unmapped ID */
+        UM_BAD_INDEX,        /* load or store past the end of a segment */
+        UM_DIVIDE_BY_ZERO,   /* division by 0 */
+        UM_UNMAP_ZERO,       /* unmap of the 0 segment */
+        UM_BAD_OUTPUT        /* output of a value above 255 */
+} Um_error;
+
+/* Values the read callback returns besides a character */
+#define UM_EOF (-1)      /* there is no more input */
+#define UM_NO_INPUT (-2) /* there is no input yet; um_run returns
+                          * UM_BLOCKED and retries the input instruction */
+
+/********** Um_io ********
+ * 
+ * The callbacks a machine does its input and output through, with a
+ * pointer passed to both. A NULL read callback gives the machine no input,
+ * and a NULL write callback throws its output away.
+ *
+ *******************/
+typedef struct Um_io {
+        int (*read)(void *cl);  /* next character 0 - 255, UM_EOF or
+                                 * UM_NO_INPUT */
+        void (*write)(void *cl, const unsigned char *bytes, size_t count);
+        void *cl;               /* passed to both callbacks */
+} Um_io;
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern Um_vm um_new(const unsigned char *program, size_t num_bytes,
+                    Um_io io);
+extern Um_status um_run(Um_vm vm, uint64_t max_instructions);
+extern Um_status um_step(Um_vm vm);
+extern Um_error um_error(Um_vm vm);
+extern const char *um_error_message(Um_error error);
+extern uint64_t um_instructions(Um_vm vm);
+extern uint32_t um_register(Um_vm vm, unsigned index);
+extern uint32_t um_prog_counter(Um_vm vm);
+extern void um_free(Um_vm *vm);
+
+#endif
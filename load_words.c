@@ -0,0 +1,151 @@
+/**************************************************************
+ *
+ *                     load_words.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of the bulk big-endian to host conversion used
+ *              to load program images. On x86 the words are byte-swapped 8
+ *              or 4 at a time with AVX2 or SSSE3 byte shuffles, chosen when
+ *              the program runs based on what the processor supports; every
+ *              other target, and the tail of every image, uses a scalar
+ *              loop.
+ * 
+ **************************************************************/
+
+#include "load_words.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/* Declaration for the scalar conversion of the words left over */
+static void load_scalar(uint32_t *words, const unsigned char *bytes,
+                        size_t count);
+
+#ifdef X86_SIMD
+
+/**************** load_avx2 ****************
+ * 
+ * Converts count big-endian words to host words 8 at a time with AVX2.
+ *
+ * Parameters:
+ *      uint32_t *words:            array of count words to fill
+ *      const unsigned char *bytes: the 4 * count bytes of the image
+ *      size_t count:               number of words to convert
+ * Returns:
+ *      None
+ * Expects:
+ *      The processor supports AVX2. words and bytes may be the same memory.
+ *
+ ********************************************/
+__attribute__((target("avx2")))
+static void load_avx2(uint32_t *words, const unsigned char *bytes,
+                      size_t count)
+{
+        /* Shuffle that reverses the 4 bytes of every word in each lane */
+        const __m256i reverse = _mm256_setr_epi8(
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+                __m256i v = _mm256_loadu_si256(
+                        (const __m256i *)(bytes + 4 * i));
+                _mm256_storeu_si256((__m256i *)(words + i),
+                                    _mm256_shuffle_epi8(v, reverse));
+        }
+        load_scalar(words + i, bytes + 4 * i, count - i);
+}
+
+/**************** load_ssse3 ****************
+ * 
+ * Converts count big-endian words to host words 4 at a time with SSSE3.
+ *
+ * Parameters:
+ *      uint32_t *words:            array of count words to fill
+ *      const unsigned char *bytes: the 4 * count bytes of the image
+ *      size_t count:               number of words to convert
+ * Returns:
+ *      None
+ * Expects:
+ *      The processor supports SSSE3. words and bytes may be the same memory.
+ *
+ ********************************************/
+__attribute__((target("ssse3")))
+static void load_ssse3(uint32_t *words, const unsigned char *bytes,
+                       size_t count)
+{
+        /* Shuffle that reverses the 4 bytes of every word */
+        const __m128i reverse = _mm_setr_epi8(
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(bytes + 4 * i));
+                _mm_storeu_si128((__m128i *)(words + i),
+                                 _mm_shuffle_epi8(v, reverse));
+        }
+        load_scalar(words + i, bytes + 4 * i, count - i);
+}
+
+#endif
+
+/**************** load_big_endian ****************
+ * 
+ * Converts the big-endian 32-bit words of a program image into host words.
+ *
+ * Parameters:
+ *      uint32_t *words:            array of count words to fill
+ *      const unsigned char *bytes: the 4 * count bytes of the image, most
+ *                                  significant byte of each word first
+ *      size_t count:               number of words to convert
+ * Returns:
+ *      None
+ * Expects:
+ *      words and bytes are not NULL unless count is 0. They may be the same
+ *      memory, to convert a buffer in place, but may not otherwise overlap.
+ *
+ ********************************************/
+extern void load_big_endian(uint32_t *words, const unsigned char *bytes,
+                            size_t count)
+{
+#ifdef X86_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                load_avx2(words, bytes, count);
+                return;
+        }
+        if (__builtin_cpu_supports("ssse3")) {
+                load_ssse3(words, bytes, count);
+                return;
+        }
+#endif
+        load_scalar(words, bytes, count);
+}
+
+/**************** load_scalar ****************
+ * 
+ * Converts count big-endian words to host words one at a time.
+ *
+ * Parameters:
+ *      uint32_t *words:            array of count words to fill
+ *      const unsigned char *bytes: the 4 * count bytes of the image
+ *      size_t count:               number of words to convert
+ * Returns:
+ *      None
+ * Expects:
+ *      words and bytes may be the same memory.
+ *
+ ********************************************/
+static void load_scalar(uint32_t *words, const unsigned char *bytes,
+                        size_t count)
+{
+        for (size_t i = 0; i < count; i++) {
+                const unsigned char *b = bytes + 4 * i;
+                words[i] = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+                           ((uint32_t)b[2] << 8) | (uint32_t)b[3];
+        }
+}
@@ -0,0 +1,26 @@
+/**************************************************************
+ *
+ *                     load_words.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Declaration of the function that converts the big-endian
+ *              words of a UM program image into host words in bulk.
+ * 
+ **************************************************************/
+
+#ifndef LOAD_WORDS_H
+#define LOAD_WORDS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern void load_big_endian(uint32_t *words, const unsigned char *bytes,
+                                                                 size_t count);
+
+#endif
@@ -0,0 +1,174 @@
+/**************************************************************
+ *
+ *                     machine.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of the functions that create and free the
+ *              state of a Universal Machine, and of the descriptions of why
+ *              a program failed.
+ * 
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "machine.h"
+#include "profile.h"
+#include "mem.h"
+#include "assert.h"
+
+/**************** new_machine ****************
+ * 
+ * Creates a new machine with every register set to 0, an empty address
+ * space, an input buffer that reads from stdin, and an output buffer that
+ * writes to stdout.
+ *
+ * Parameters:
+ *      Output_mode output_mode: when the machine's output is written
+ * Returns:
+ *      the new Machine
+ * Expects:
+ *      The client frees the machine with free_machine.
+ *
+ ********************************************/
+extern Machine new_machine(Output_mode output_mode)
+{
+        return new_machine_io(output_mode, STDIN_FILENO, STDOUT_FILENO);
+}
+
+/**************** new_machine_io ****************
+ * 
+ * Creates a new machine like new_machine, but whose input and output go
+ * through the given file descriptors.
+ *
+ * Parameters:
+ *      Output_mode output_mode: when the machine's output is written
+ *      int in_fd:               where the machine's input is read from
+ *      int out_fd:              where the machine's output is written
+ * Returns:
+ *      the new Machine
+ * Expects:
+ *      The client frees the machine with free_machine, which leaves both
+ *      file descriptors open.
+ *
+ ********************************************/
+extern Machine new_machine_io(Output_mode output_mode, int in_fd, int out_fd)
+{
+        return new_machine_buffers(new_input_buffer(in_fd),
+                                   new_output_buffer(out_fd, output_mode));
+}
+
+/**************** new_machine_buffers ****************
+ * 
+ * Creates a new machine like new_machine, but whose input and output go
+ * through the given buffers.
+ *
+ * Parameters:
+ *      Input_buffer in:   where the machine's input is read from
+ *      Output_buffer out: where the machine's output is written
+ * Returns:
+ *      the new Machine
+ * Expects:
+ *      in and out are not NULL. The machine takes ownership of both
+ *      buffers, and the client frees the machine with free_machine.
+ *
+ ********************************************/
+extern Machine new_machine_buffers(Input_buffer in, Output_buffer out)
+{
+        assert(in != NULL && out != NULL);
+        Machine vm;
+        NEW(vm);
+
+        /* Initialize 8 registers and set each to 0 */
+        for (int i = 0; i < NUM_REGISTERS; i++) {
+                vm->registers[i] = 0;
+        }
+        vm->prog_counter = 0;
+
+        /* Create a new address space and take the input and output buffers */
+        vm->space = new_address_space();
+        vm->in = in;
+        vm->out = out;
+
+        /* Instructions are only counted if the client asks for it */
+        vm->stats = NULL;
+        vm->profiling = false;
+        vm->failure = NULL;
+        vm->failure_code = FAILURE_NONE;
+
+        /* Only the scheduled engine runs in turns and keeps these */
+        vm->quantum = 0;
+        vm->instructions = 0;
+        vm->state = MACHINE_READY;
+        return vm;
+}
+
+/**************** free_machine ****************
+ * 
+ * Writes out the machine's remaining output, prints its counters and its
+ * profile on stderr if it kept any, frees all of its memory, and sets the
+ * client's pointer to NULL.
+ *
+ * Parameters:
+ *      Machine *vm: pointer to the machine to free
+ * Returns:
+ *      None
+ * Expects:
+ *      vm and *vm are not NULL.
+ *
+ ********************************************/
+extern void free_machine(Machine *vm)
+{
+        assert(vm != NULL && *vm != NULL);
+
+        /* Flush and free the output, print the profile, print and free the
+         * counters, free the input, then free all the segments */
+        free_output_buffer(&(*vm)->out);
+        if ((*vm)->profiling) {
+                stop_profile(stderr);
+        }
+        if ((*vm)->stats != NULL) {
+                print_stats(stderr, (*vm)->stats,
+                            segment_stats((*vm)->space),
+                            input_consumed((*vm)->in));
+                free_stats(&(*vm)->stats);
+        }
+        free_input_buffer(&(*vm)->in);
+        free_all_segments((*vm)->space);
+
+        FREE(*vm);
+}
+
+/**************** failure_message ****************
+ *
+ * Returns the description of why a program failed that um prints.
+ *
+ * Parameters:
+ *      Machine_failure failure: why the program failed
+ * Returns:
+ *      the description, which is "no failure" for FAILURE_NONE
+ *
+ ********************************************/
+extern const char *failure_message(Machine_failure failure)
+{
+        switch (failure) {
+        case FAILURE_NONE:
+                return "no failure";
+        case FAILURE_BAD_INSTRUCTION:
+                return "invalid instruction";
+        case FAILURE_UNMAPPED_SEGMENT:
+                return "segment is not mapped";
+        case FAILURE_BAD_INDEX:
+                return "index is outside the segment";
+        case FAILURE_DIVIDE_BY_ZERO:
+                return "division by zero";
+        case FAILURE_UNMAP_ZERO:
+                return "unmap of the 0 segment";
+        case FAILURE_BAD_OUTPUT:
+                return "output value above 255";
+        }
+        return "unknown failure";
+}
@@ -0,0 +1,84 @@
+/**************************************************************
+ *
+ *                     machine.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Declaration of the Machine struct, which holds the state of
+ *              one running Universal Machine (its registers, address space
+ *              and input and output buffers), and of the functions that
+ *              create and free one. The execution engines and the operations
+ *              module work on the fields directly.
+ * 
+ **************************************************************/
+
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "segment.h"
+#include "output_buffer.h"
+#include "input_buffer.h"
+#include "stats.h"
+
+/* Number of registers in the Universal Machine */
+#define NUM_REGISTERS 8
+
+/*****************************************************************
+ *                  Machine Declaration
+ *****************************************************************/
+typedef struct Machine *Machine;
+
+/* Where the scheduled engine left a machine: able to run on, waiting for
+ * input, waiting for its output to be written, or stopped because it
+ * halted, ran off the end of the 0 segment or failed */
+typedef enum Machine_state {
+        MACHINE_READY = 0, MACHINE_BLOCKED, MACHINE_BLOCKED_OUTPUT,
+        MACHINE_STOPPED
+} Machine_state;
+
+/* Why a program failed, if it did. failure_message gives the description
+ * of each that is printed */
+typedef enum Machine_failure {
+        FAILURE_NONE = 0, FAILURE_BAD_INSTRUCTION, FAILURE_UNMAPPED_SEGMENT,
+        FAILURE_BAD_INDEX, FAILURE_DIVIDE_BY_ZERO, FAILURE_UNMAP_ZERO,
+        FAILURE_BAD_OUTPUT
+} Machine_failure;
+
+/********** Machine ********
+ * 
+ * Struct to hold the state of one Universal Machine.
+ *
+ *******************/
+struct Machine {
+        uint32_t registers[NUM_REGISTERS]; /* registers 0 - 7 */
+        uint32_t prog_counter;             /* where the engine starts */
+        Address_space space;               /* the segments of the machine */
+        Input_buffer in;                   /* characters waiting to be input */
+        Output_buffer out;                 /* characters the program output */
+        Um_stats *stats;                   /* counters, or NULL if not kept */
+        bool profiling;                    /* whether the profiler runs */
+        const char *failure;               /* why the program failed, or
+                                            * NULL */
+        Machine_failure failure_code;      /* the same as a code */
+        uint64_t quantum;                  /* instructions the scheduled
+                                            * engine runs in one turn */
+        uint64_t instructions;             /* instructions the scheduled
+                                            * engine has run */
+        Machine_state state;               /* where the scheduled engine
+                                            * left the machine */
+};
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern Machine new_machine(Output_mode output_mode);
+extern Machine new_machine_io(Output_mode output_mode, int in_fd, int out_fd);
+extern Machine new_machine_buffers(Input_buffer in, Output_buffer out);
+extern void free_machine(Machine *vm);
+extern const char *failure_message(Machine_failure failure);
+
+#endif
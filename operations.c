@@ -17,21 +17,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
-#include "seq.h"
-#include "uarray.h"
 #include "operations.h"
-
-/********** Address_space ********
- * 
- * Struct to hold all the information needed to manage the segments in the
- * address space, including the sequence of segments in use, the number of
- * segments, and the sequence of unmapped segments.
- *
- *******************/
-struct Address_space {
-        Seq_T in_use; /* Seq_T of all segments that contain UArrays of words */
-        Seq_T unmapped; /* Seq_T of all of the unmapped segments */
-};
+#include "segment_private.h"
 
 /* Constant for the maximum value of a 32-bit word */
 #define NUM_MAX 4294967296
@@ -222,7 +209,7 @@ extern void seg_load(Address_space space, uint32_t *regs, uint32_t a,
 {
         /* Set the value in register a to the value of the word at the segment
          * in register b and the offset in register c */
-        regs[a] = *(uint32_t *)word_at(space, regs[b], regs[c]);
+        regs[a] = *segment_word(space, regs[b], regs[c]);
 }
 
 /****************** seg_store *******************
@@ -245,7 +232,9 @@ extern void seg_load(Address_space space, uint32_t *regs, uint32_t a,
  *      a, b, c are valid register numbers (0-7).
  * Notes: 
  *      The value in register c is stored in the word at the segment in 
- *      register a and the offset in register b.
+ *      register a and the offset in register b. A segment shared by a LOADP
+ *      is copied before it is written. If that segment is the 0
+ *      segment, the decoded instruction for the word is updated as well.
  *
  ********************************************/
 extern void seg_store(Address_space space, uint32_t *regs, uint32_t a, 
@@ -253,88 +242,110 @@ extern void seg_store(Address_space space, uint32_t *regs, uint32_t a,
 {
         /* Get the word at the address in register a and the offset of 
          * register b and store value in register c to that word location */
-        uint32_t *word = word_at(space, regs[a], regs[b]);
+        uint32_t *word = writable_word(space, regs[a], regs[b]);
         *word = regs[c];
+
+        /* A store into the 0 segment may change an instruction, so the
+         * decoded copy of that word is refreshed */
+        if (regs[a] == 0) {
+                decode_word(space, regs[b]);
+        }
 }
 
 /****************** halt *******************
  * 
- * Ends the program by freeing all the segments in the address space and 
- * exiting the program.
+ * Ends the program by writing out the machine's remaining output. The
+ * engine that called it returns right after, and its caller frees the
+ * machine as it does when the program counter runs off the end.
  *
  * Parameters:
- *       Address_space space: pointer to an address space struct
+ *       Machine vm: pointer to the machine being halted
  * Returns:
  *       None.
  * Expects:
- *      space is not NULL and is a valid pointer to an address space struct.
+ *      vm is not NULL and is a valid pointer to a machine.
  * Notes: 
- *      All the segments in the address space are freed and the program exits.
+ *      The process is not exited, so that several machines can run in one
+ *      process and one halting does not end the others.
  *
  ********************************************/
-extern void halt(Address_space space)
+extern void halt(Machine vm)
 {
-        /* Free all the segments in the address space */
-        free_all_segments(space);
-
-        /* Exit the program */
-        exit(0);
+        /* Write out the output now, before the machine is freed */
+        flush_output(vm->out);
 }
 
 /****************** output *******************
  * 
- * Outputs the character in register c to stdout.
+ * Outputs the character in register c to the machine's output buffer.
  *
  * Parameters:
- *      uint32_t *regs:  pointer to an array of 8 32-bit registers
- *      uint32_t c:      register containing the character to output
+ *      Output_buffer out: the machine's output buffer
+ *      uint32_t *regs:    pointer to an array of 8 32-bit registers
+ *      uint32_t c:        register containing the character to output
  * Returns:
  *      None.
  * Expects:
+ *      out is not NULL.
  *      uint32_t *regs is not NULL and is a valid pointer to an array of 8
  *      32-bit registers.   
  *      c is a valid register number (0-7).
  *      The value in register c is a valid ASCII character. If it is not, a CRE
  *      is raised.
  * Notes: 
- *      The character in register c is output to stdout.
+ *      The character in register c is added to the output buffer, which
+ *      writes it to stdout when the buffer fills, is flushed, or (in line
+ *      mode) reaches a newline.
  *
  ********************************************/
-extern void output(uint32_t *regs, uint32_t c)
+extern void output(Output_buffer out, uint32_t *regs, uint32_t c)
 {
         /* Check if register c is valid */
         assert(regs[c] < MAX_ASCII);
 
         /* Output the character in register c */
-        printf("%c", regs[c]);
+        put_output(out, (unsigned char)regs[c]);
 }
 
 /****************** input *******************
  * 
- * Gets input from stdin and stores it in register c. If EOF is reached, the
- * value in register c is set to a 32-bit word in which every bit is 1.
+ * Gets the next character of input and stores it in register c. If EOF is
+ * reached, the value in register c is set to a 32-bit word in which every bit
+ * is 1.
  *
  * Parameters:
- *        uint32_t *regs:  pointer to an array of 8 32-bit registers
- *        uint32_t c:      register to store the input
+ *        Input_buffer in:   the machine's input buffer
+ *        Output_buffer out: the machine's output buffer
+ *        uint32_t *regs:    pointer to an array of 8 32-bit registers
+ *        uint32_t c:        register to store the input
  * Returns:
  *        None.
  * Expects:
+ *      in and out are not NULL.
  *      uint32_t *regs is not NULL and is a valid pointer to an array of 8
  *      32-bit registers.   
  *      c is a valid register number (0-7).
  *      The value inputted is a valid ASCII character. If it is not, a CRE is
  *      raised.
  * Notes: 
- *      The value in register c is set to the input from stdin. If EOF is 
+ *      If no input is waiting in the input buffer, the output buffer is
+ *      flushed first so that any prompt the program printed is visible before
+ *      it waits for input.
+ *      The value in register c is set to the next input character. If EOF is 
  *      reached, the value in register c is set to a 32-bit word in which every
  *      bit is 1.
  *
  ********************************************/
-extern void input(uint32_t *regs, uint32_t c)
+extern void input(Input_buffer in, Output_buffer out, uint32_t *regs,
+                  uint32_t c)
 {
-        /* Get input from stdin */
-        int input = getchar();
+        /* Show any pending output before waiting for input */
+        if (input_pending(in) == 0) {
+                flush_output(out);
+        }
+
+        /* Get the next character from the input buffer */
+        int input = get_input(in);
 
         /* Check if input is valid */
         assert(input < MAX_ASCII);
@@ -371,11 +382,13 @@ extern void input(uint32_t *regs, uint32_t c)
  *      b, c are valid register numbers (0-7).
  *      prog_counter and num_inst are not NULL.
  * Notes: 
- *      If the value in register b is not 0, segment 0 is freed abandoned by 
- *      being freed and the program in the segment in register b is loaded into
- *      the 0 segment. The program counter is set to the value in register c 
- *      and the number of instructions is set to the length of the segment in 
- *      the 0 segment.
+ *      If the value in register b is not 0, segment 0 is abandoned by being
+ *      released and the 0 segment becomes an alias of the segment in register
+ *      b, which is only copied once either of them is written (copy on
+ *      write). The program counter is set to the value in register c and the
+ *      number of instructions is set to the length of the segment in the 0
+ *      segment. The decoded copy of the 0 segment is rebuilt, which
+ *      invalidates any pointer previously returned by decoded_program.
  *
  ********************************************/
 extern void load_program(Address_space space, uint32_t *regs, uint32_t b, 
@@ -383,33 +396,26 @@ extern void load_program(Address_space space, uint32_t *regs, uint32_t b,
 {
         /* Check if register b is not 0 */
         if (regs[b] != 0) {
-                /* Free segment 0 */
-                free_segment(space, 0);
-
-                /* Fetch the length of the segment being duplicated */
-                int len = UArray_length(Seq_get(space->in_use, regs[b]));
+                /* CRE if the segment being loaded is not mapped */
+                uint32_t ID = regs[b];
+                assert(ID < space->num_segments);
+                Segment *source = space->segments[ID];
+                assert(source != NULL);
 
-                /* Create a new segment of the length of the segment being 
-                 * duplicated with each element being the size of a 32-bit
-                 * word */
-                UArray_T new_seg = UArray_new(len, sizeof(uint32_t));
+                /* Make the 0 segment an alias of the segment being loaded
+                 * rather than a copy of it. If it already is one, the
+                 * decoded program is still current */
+                if (space->segments[0] != source) {
+                        share_segment(space, ID, 0);
 
-                /* Copy the contents of the segment being duplicated to the
-                 * newly created segment */
-                for (int seg_index = 0; seg_index < len; seg_index++) {
-                        uint32_t *orig_word = word_at(space, regs[b],
-                                                                    seg_index);
-                        uint32_t *copied_word = UArray_at(new_seg, seg_index);
-                        *copied_word = *orig_word;
+                        /* Decode the new 0 segment for the engines */
+                        decode_program(space);
                 }
-
-                /* Add the newly duplicated segment to the position of segment 
-                 * 0 in the sequence of segments */
-                Seq_put(space->in_use, 0, new_seg);
+                space->stats.loadp_shared++;
 
                 /* Update the number of instructions to the length of the 
-                 * newly duplicated segment that is now in the 0 segment */
-                *num_inst = (size_t)len;
+                 * segment that is now in the 0 segment */
+                *num_inst = (size_t)source->length;
         }
         /* Update the program counter to the value in register c */
         *prog_counter = (size_t)(regs[c]);
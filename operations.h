@@ -17,6 +17,9 @@
 #define OPERATIONS_H
 
 #include "segment.h"
+#include "machine.h"
+#include "output_buffer.h"
+#include "input_buffer.h"
 
 /*****************************************************************
  *                  Arithmetic Function Declarations
@@ -34,13 +37,14 @@ extern void seg_load(Address_space space, uint32_t *regs, uint32_t a,
                      uint32_t b, uint32_t c);
 extern void seg_store(Address_space space, uint32_t *regs, uint32_t a, 
                       uint32_t b, uint32_t c);
-extern void halt(Address_space space);
+extern void halt(Machine vm);
 
 /*****************************************************************
  *                  I/O Function Declarations
  *****************************************************************/
-extern void output(uint32_t *regs, uint32_t c);
-extern void input(uint32_t *regs, uint32_t c);
+extern void output(Output_buffer out, uint32_t *regs, uint32_t c);
+extern void input(Input_buffer in, Output_buffer out, uint32_t *regs,
+                  uint32_t c);
 
 /*****************************************************************
  *                  Segment Function Declarations
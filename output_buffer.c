@@ -0,0 +1,409 @@
+/**************************************************************
+ *
+ *                     output_buffer.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of the Output_buffer ADT. Characters are
+ *              collected in a fixed block and written with write(2) when the
+ *              block fills, when the buffer is flushed (before input, on halt
+ *              and when it is freed), and after each newline in line mode.
+ *              If the file descriptor is non-blocking and cannot take all
+ *              of the output, the rest stays in the block and the buffer is
+ *              stalled until a later flush writes it.
+ *              Every live buffer is also flushed if the process exits or
+ *              aborts without freeing it, as it does on a failed assertion.
+ *              Buffers may be created and freed by several threads at once,
+ *              as in batch mode, so the list of live buffers is locked.
+ * 
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include "output_buffer.h"
+#include "mem.h"
+#include "assert.h"
+
+/* Number of characters collected before the buffer is written */
+#define OUTPUT_BLOCK 65536
+
+/********** Output_buffer ********
+ * 
+ * Struct to hold the characters waiting to be written, the file descriptor
+ * or writer they go to, and how often they are written. Live buffers with
+ * a file descriptor are kept in a list so that they can be flushed when the
+ * process ends abnormally.
+ *
+ *******************/
+struct Output_buffer {
+        int fd;                           /* where the output is written */
+        Output_writer write;              /* callback written to instead of
+                                           * fd, or NULL */
+        void *cl;                         /* passed to write */
+        Output_mode mode;                 /* when the output is written */
+        size_t length;                    /* characters waiting in block */
+        bool stalled;                     /* whether fd took too few */
+        unsigned char block[OUTPUT_BLOCK]; /* characters waiting */
+        struct Output_buffer *next;       /* next live buffer */
+};
+
+/* List of live buffers, whether the exit handlers are installed, and the
+ * lock that guards both */
+static struct Output_buffer *live_buffers = NULL;
+static bool handlers_installed = false;
+static pthread_mutex_t live_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Declarations for the helpers that write out buffers when the process ends
+ * without freeing them */
+static void flush_live_buffers(void);
+static void flush_on_exit(void);
+static void flush_on_abort(int signal_number);
+
+/**************** new_output_buffer ****************
+ * 
+ * Creates a new, empty output buffer that writes to the given file
+ * descriptor.
+ *
+ * Parameters:
+ *      int fd:           the file descriptor the output is written to
+ *      Output_mode mode: when the output is written. OUTPUT_DEFAULT picks
+ *                        line mode if fd is a terminal and full buffering
+ *                        otherwise.
+ * Returns:
+ *      the new Output_buffer
+ * Expects:
+ *      The client frees the buffer with free_output_buffer.
+ *
+ ********************************************/
+extern Output_buffer new_output_buffer(int fd, Output_mode mode)
+{
+        Output_buffer out;
+        NEW(out);
+
+        /* Pick line mode for terminals so that prompts appear right away */
+        if (mode == OUTPUT_DEFAULT) {
+                mode = isatty(fd) ? OUTPUT_LINE : OUTPUT_FULL;
+        }
+        out->fd = fd;
+        out->write = NULL;
+        out->cl = NULL;
+        out->mode = mode;
+        out->length = 0;
+        out->stalled = false;
+
+        /* Flush the output if the process exits or aborts first */
+        pthread_mutex_lock(&live_lock);
+        if (!handlers_installed) {
+                atexit(flush_on_exit);
+                signal(SIGABRT, flush_on_abort);
+                handlers_installed = true;
+        }
+        out->next = live_buffers;
+        live_buffers = out;
+        pthread_mutex_unlock(&live_lock);
+        return out;
+}
+
+/**************** new_output_writer ****************
+ * 
+ * Creates a new, empty output buffer that hands its characters to the
+ * given callback whenever the block fills or the buffer is flushed.
+ *
+ * Parameters:
+ *      Output_writer write: the callback the output goes to, or NULL to
+ *                           throw the output away
+ *      void *cl:            passed to every call of write
+ * Returns:
+ *      the new Output_buffer
+ * Expects:
+ *      The client frees the buffer with free_output_buffer.
+ * Notes:
+ *      The buffer is not flushed when the process exits, since the client
+ *      owns what write works on. It never stalls, and output_fd returns -1.
+ *
+ ********************************************/
+extern Output_buffer new_output_writer(Output_writer write, void *cl)
+{
+        Output_buffer out;
+        NEW(out);
+        out->fd = -1;
+        out->write = write;
+        out->cl = cl;
+        out->mode = write == NULL ? OUTPUT_NULL : OUTPUT_FULL;
+        out->length = 0;
+        out->stalled = false;
+        out->next = NULL;
+        return out;
+}
+
+/**************** put_output ****************
+ * 
+ * Adds one character to the output, writing the buffer out if it is full or,
+ * in line mode, if the character is a newline.
+ *
+ * Parameters:
+ *      Output_buffer out: the buffer to add the character to
+ *      unsigned char c:   the character
+ * Returns:
+ *      None
+ * Expects:
+ *      out is not NULL.
+ * Notes:
+ *      If the block is still full from a stalled flush, this waits for the
+ *      file descriptor to take it; callers that must not wait check
+ *      output_ready first.
+ *
+ ********************************************/
+extern void put_output(Output_buffer out, unsigned char c)
+{
+        /* Null mode throws the output away */
+        if (out->mode == OUTPUT_NULL) {
+                return;
+        }
+
+        if (out->length == OUTPUT_BLOCK) {
+                drain_output(out);
+        }
+
+        out->block[out->length++] = c;
+        if (out->length == OUTPUT_BLOCK ||
+            (c == '\n' && out->mode == OUTPUT_LINE)) {
+                flush_output(out);
+        }
+}
+
+/**************** flush_output ****************
+ * 
+ * Writes every character waiting in the buffer to its file descriptor, or
+ * as many as a non-blocking file descriptor takes without waiting.
+ *
+ * Parameters:
+ *      Output_buffer out: the buffer to flush
+ * Returns:
+ *      None
+ * Expects:
+ *      out is not NULL. Errors writing the output, such as a closed pipe,
+ *      drop the waiting characters.
+ * Notes:
+ *      The characters a non-blocking file descriptor does not take are
+ *      moved to the front of the block and the buffer is stalled until a
+ *      flush writes them all. Only write(2) and memmove are used, so this
+ *      may be called from a signal handler.
+ *
+ ********************************************/
+extern void flush_output(Output_buffer out)
+{
+        /* A writer takes the whole block at once */
+        if (out->fd < 0) {
+                if (out->write != NULL && out->length > 0) {
+                        out->write(out->cl, out->block, out->length);
+                }
+                out->length = 0;
+                return;
+        }
+
+        size_t written = 0;
+        while (written < out->length) {
+                ssize_t n = write(out->fd, out->block + written,
+                                  out->length - written);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        out->length -= written;
+                        memmove(out->block, out->block + written,
+                                out->length);
+                        out->stalled = true;
+                        return;
+                }
+                if (n <= 0) {
+                        break;
+                }
+                written += (size_t)n;
+        }
+        out->length = 0;
+        out->stalled = false;
+}
+
+/**************** drain_output ****************
+ * 
+ * Writes every character waiting in the buffer, waiting for a non-blocking
+ * file descriptor to take them if it has to.
+ *
+ * Parameters:
+ *      Output_buffer out: the buffer to drain
+ * Returns:
+ *      None
+ * Expects:
+ *      out is not NULL.
+ * Notes:
+ *      Only write(2), memmove and poll(2) are used, so this may be called
+ *      from a signal handler.
+ *
+ ********************************************/
+extern void drain_output(Output_buffer out)
+{
+        flush_output(out);
+        while (out->stalled) {
+                struct pollfd poller = { out->fd, POLLOUT, 0 };
+                poll(&poller, 1, -1);
+                flush_output(out);
+        }
+}
+
+/**************** output_ready ****************
+ * 
+ * Returns whether put_output can take a character without waiting, first
+ * trying to write out a full block left by a stalled flush.
+ *
+ * Parameters:
+ *      Output_buffer out: the buffer to check
+ * Returns:
+ *      true if there is room in the block for a character
+ * Expects:
+ *      out is not NULL.
+ *
+ ********************************************/
+extern bool output_ready(Output_buffer out)
+{
+        if (out->length == OUTPUT_BLOCK) {
+                flush_output(out);
+        }
+        return out->length < OUTPUT_BLOCK;
+}
+
+/**************** output_stalled ****************
+ * 
+ * Returns whether the last flush left characters that its file descriptor
+ * would not take without waiting.
+ *
+ * Parameters:
+ *      Output_buffer out: the buffer to check
+ * Returns:
+ *      true if the buffer is stalled
+ * Expects:
+ *      out is not NULL.
+ *
+ ********************************************/
+extern bool output_stalled(Output_buffer out)
+{
+        return out->stalled;
+}
+
+/**************** output_fd ****************
+ * 
+ * Returns the file descriptor the buffer writes to, for clients that wait
+ * for it to take more output.
+ *
+ * Parameters:
+ *      Output_buffer out: the buffer to report on
+ * Returns:
+ *      the file descriptor, or -1 if the buffer has a writer
+ * Expects:
+ *      out is not NULL.
+ *
+ ********************************************/
+extern int output_fd(Output_buffer out)
+{
+        return out->fd;
+}
+
+/**************** free_output_buffer ****************
+ * 
+ * Flushes and frees the given output buffer and sets the client's pointer
+ * to NULL.
+ *
+ * Parameters:
+ *      Output_buffer *out: pointer to the buffer to free
+ * Returns:
+ *      None
+ * Expects:
+ *      out and *out are not NULL.
+ *
+ ********************************************/
+extern void free_output_buffer(Output_buffer *out)
+{
+        assert(out != NULL && *out != NULL);
+        drain_output(*out);
+
+        /* Remove the buffer from the list of live buffers, which buffers
+         * with a writer never join */
+        if ((*out)->fd >= 0) {
+                pthread_mutex_lock(&live_lock);
+                struct Output_buffer **link = &live_buffers;
+                while (*link != *out) {
+                        link = &(*link)->next;
+                }
+                *link = (*out)->next;
+                pthread_mutex_unlock(&live_lock);
+        }
+
+        FREE(*out);
+}
+
+/**************** flush_live_buffers ****************
+ * 
+ * Flushes every buffer that has not been freed.
+ *
+ * Parameters:
+ *      None
+ * Returns:
+ *      None
+ * Expects:
+ *      The caller holds live_lock, or is a signal handler that cannot take
+ *      it.
+ *
+ ********************************************/
+static void flush_live_buffers(void)
+{
+        for (Output_buffer out = live_buffers; out != NULL; out = out->next) {
+                drain_output(out);
+        }
+}
+
+/**************** flush_on_exit ****************
+ * 
+ * Flushes every buffer that has not been freed. Installed with atexit so
+ * that output is not lost when the machine exits early.
+ *
+ * Parameters:
+ *      None
+ * Returns:
+ *      None
+ * Expects:
+ *      None
+ *
+ ********************************************/
+static void flush_on_exit(void)
+{
+        pthread_mutex_lock(&live_lock);
+        flush_live_buffers();
+        pthread_mutex_unlock(&live_lock);
+}
+
+/**************** flush_on_abort ****************
+ * 
+ * Signal handler for SIGABRT, which a failed assertion raises, that flushes
+ * every live buffer before the process is terminated.
+ *
+ * Parameters:
+ *      int signal_number: the signal being handled
+ * Returns:
+ *      None. abort terminates the process once the handler returns.
+ * Expects:
+ *      None
+ *
+ ********************************************/
+static void flush_on_abort(int signal_number)
+{
+        (void)signal_number;
+        flush_live_buffers();
+}
@@ -0,0 +1,56 @@
+/**************************************************************
+ *
+ *                     output_buffer.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Function declarations for the Output_buffer ADT, which
+ *              collects the characters a UM program outputs and writes them
+ *              to a file descriptor, or hands them to a callback, in large
+ *              blocks.
+ * 
+ **************************************************************/
+
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*****************************************************************
+ *                  Output_buffer Declaration
+ *****************************************************************/
+typedef struct Output_buffer *Output_buffer;
+
+/********** Output_mode ********
+ * 
+ * Enum to hold when an output buffer writes its contents: after every
+ * newline (interactive use), only when it is full (batch use), or never, in
+ * which case the output is thrown away (benchmarking).
+ *
+ *******************/
+typedef enum Output_mode {
+        OUTPUT_DEFAULT = 0, OUTPUT_LINE, OUTPUT_FULL, OUTPUT_NULL
+} Output_mode;
+
+/* Callback that an output buffer hands its characters to instead of
+ * writing them to a file descriptor. It takes them all */
+typedef void (*Output_writer)(void *cl, const unsigned char *bytes,
+                              size_t count);
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern Output_buffer new_output_buffer(int fd, Output_mode mode);
+extern Output_buffer new_output_writer(Output_writer write, void *cl);
+extern void put_output(Output_buffer out, unsigned char c);
+extern void flush_output(Output_buffer out);
+extern void drain_output(Output_buffer out);
+extern bool output_ready(Output_buffer out);
+extern bool output_stalled(Output_buffer out);
+extern int output_fd(Output_buffer out);
+extern void free_output_buffer(Output_buffer *out);
+
+#endif
@@ -30,6 +30,10 @@ files=(
     "segment_sl_test.um"
     "load_test_not_0.um"
     "load_test_0.um"
+    "loadp_cow_test.um"
+    "remap_test.um"
+    "sstore_0_test.um"
+    "jit_flush_test.um"
 )
 
 # Iterate through each file and run the `./um` executable
@@ -37,16 +41,22 @@ for file in "${files[@]}"; do
     # Extract the base file name without the extension
     base_name="${file%.um}"
 
+    # Tests whose name starts with "jit_" run on the JIT engine
+    engine=""
+    if [[ $base_name == jit_* ]]; then
+        engine="--engine=jit"
+    fi
+
     # Check if the base name contains "input" or is "in_and_out_test"
     if [[ $base_name == *"input"* || $base_name == "in_and_out_test" ]]; then
         # File name ends with .0 for input if it contains "input" or is "in_and_out_test"
         input_file="${base_name}.0"
         # Run the `./um` executable with the current file and input file, and save the output to a .out file
-        ./um "$file" < "$input_file" > "${base_name}.out"
+        ./um $engine "$file" < "$input_file" > "${base_name}.out"
         echo "Processed $file with input from $input_file and saved output to ${base_name}.out"
     else
         # Run the `./um` executable with the current file and save the output to a .out file
-        ./um "$file" > "${base_name}.out"
+        ./um $engine "$file" > "${base_name}.out"
         echo "Processed $file and saved output to ${base_name}.out"
     fi
 
@@ -0,0 +1,222 @@
+/**************************************************************
+ *
+ *                     profile.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of the sampling profiler. Every
+ *              PROFILE_INTERVAL microseconds of CPU time the kernel sends
+ *              SIGPROF, whose handler reads the published program counter
+ *              and 0 segment, and adds one sample to the range of
+ *              PROFILE_RANGE instructions holding it. The ranges are kept in
+ *              a fixed open-addressed table, so the handler never allocates.
+ *              When the profile is stopped, the hottest ranges are printed
+ *              as a histogram.
+ * 
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "profile.h"
+#include "assert.h"
+
+/* Microseconds of CPU time between samples */
+#ifndef PROFILE_INTERVAL
+#define PROFILE_INTERVAL 1000
+#endif
+
+/* Number of instructions grouped into one range of the histogram */
+#ifndef PROFILE_RANGE
+#define PROFILE_RANGE 64
+#endif
+
+/* Number of ranges the table can hold (a power of 2) and the number of
+ * ranges printed */
+#define PROFILE_SLOTS 4096
+#define PROFILE_TOP 32
+
+/********** Profile_range ********
+ * 
+ * One range of the histogram: the segment its 0 segment was loaded from,
+ * the index of the range within it, and the samples that fell in it. A slot
+ * with no samples is empty.
+ *
+ *******************/
+typedef struct Profile_range {
+        uint32_t program;
+        uint32_t range;
+        uint64_t samples;
+} Profile_range;
+
+volatile uint32_t profile_pc = 0;
+volatile uint32_t profile_program = 0;
+
+/* The histogram, and the samples that did not fit in it */
+static Profile_range ranges[PROFILE_SLOTS];
+static uint64_t dropped = 0;
+
+/* The SIGPROF action that was in place before the profile started */
+static struct sigaction old_action;
+
+/* Declarations for the signal handler and the sort used to print */
+static void take_sample(int signal_number);
+static int compare_ranges(const void *a, const void *b);
+
+/**************** start_profile ****************
+ * 
+ * Clears the histogram, installs the SIGPROF handler and starts the timer.
+ *
+ * Parameters:
+ *      None
+ * Returns:
+ *      None
+ * Expects:
+ *      No profile is running, and the client calls stop_profile before the
+ *      process exits.
+ *
+ ********************************************/
+extern void start_profile(void)
+{
+        memset(ranges, 0, sizeof(ranges));
+        dropped = 0;
+        profile_pc = 0;
+        profile_program = 0;
+
+        /* Restart system calls so sampling cannot interrupt I/O */
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = take_sample;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, &old_action);
+
+        struct itimerval timer;
+        timer.it_interval.tv_sec = 0;
+        timer.it_interval.tv_usec = PROFILE_INTERVAL;
+        timer.it_value = timer.it_interval;
+        setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+/**************** stop_profile ****************
+ * 
+ * Stops the timer, restores the previous SIGPROF action, and prints the
+ * PROFILE_TOP ranges with the most samples, hottest first.
+ *
+ * Parameters:
+ *      FILE *fp: the stream the histogram is printed to
+ * Returns:
+ *      None
+ * Expects:
+ *      fp is not NULL and start_profile was called.
+ * Notes:
+ *      Each line gives the ID of the segment the 0 segment was loaded from
+ *      (0 for the program um was started with), the range of program
+ *      counters, the samples in it and their share of all samples, and a
+ *      bar proportional to that share.
+ *
+ ********************************************/
+extern void stop_profile(FILE *fp)
+{
+        assert(fp != NULL);
+
+        struct itimerval timer;
+        memset(&timer, 0, sizeof(timer));
+        setitimer(ITIMER_PROF, &timer, NULL);
+        sigaction(SIGPROF, &old_action, NULL);
+
+        /* Gather the ranges that were sampled at the front of the table */
+        int num_ranges = 0;
+        uint64_t total = dropped;
+        for (int i = 0; i < PROFILE_SLOTS; i++) {
+                if (ranges[i].samples != 0) {
+                        total += ranges[i].samples;
+                        ranges[num_ranges++] = ranges[i];
+                }
+        }
+        qsort(ranges, num_ranges, sizeof(Profile_range), compare_ranges);
+
+        fprintf(fp, "profile: %llu samples every %d us, %d instructions per "
+                    "range, %llu dropped\n", (unsigned long long)total,
+                PROFILE_INTERVAL, PROFILE_RANGE,
+                (unsigned long long)dropped);
+        fprintf(fp, "%8s  %-23s %10s %7s\n", "program", "pc range", "samples",
+                "%");
+        for (int i = 0; i < num_ranges && i < PROFILE_TOP; i++) {
+                uint64_t first = (uint64_t)ranges[i].range * PROFILE_RANGE;
+                double share = 100.0 * ranges[i].samples / total;
+                fprintf(fp, "%8u  [%9llu, %9llu) %10llu %6.2f%% ",
+                        ranges[i].program, (unsigned long long)first,
+                        (unsigned long long)(first + PROFILE_RANGE),
+                        (unsigned long long)ranges[i].samples, share);
+                for (int bar = 0; bar < (int)(share / 2); bar++) {
+                        fputc('#', fp);
+                }
+                fputc('\n', fp);
+        }
+}
+
+/**************** take_sample ****************
+ * 
+ * SIGPROF handler that adds one sample to the range holding the published
+ * program counter.
+ *
+ * Parameters:
+ *      int signal_number: the signal being handled
+ * Returns:
+ *      None
+ * Expects:
+ *      None
+ * Notes:
+ *      The handler only reads the two published globals and writes the
+ *      static table, so it is safe to run between any two instructions of
+ *      the engine. A sample whose range does not fit in the full table is
+ *      counted as dropped.
+ *
+ ********************************************/
+static void take_sample(int signal_number)
+{
+        (void)signal_number;
+        uint32_t program = profile_program;
+        uint32_t range = profile_pc / PROFILE_RANGE;
+
+        uint32_t slot = (program * 0x9E3779B1u ^ range * 0x85EBCA77u) &
+                        (PROFILE_SLOTS - 1);
+        for (int probes = 0; probes < PROFILE_SLOTS; probes++) {
+                Profile_range *entry = &ranges[slot];
+                if (entry->samples == 0) {
+                        entry->program = program;
+                        entry->range = range;
+                }
+                if (entry->program == program && entry->range == range) {
+                        entry->samples++;
+                        return;
+                }
+                slot = (slot + 1) & (PROFILE_SLOTS - 1);
+        }
+        dropped++;
+}
+
+/**************** compare_ranges ****************
+ * 
+ * qsort comparison that orders ranges by decreasing samples, then by
+ * program and range.
+ *
+ ********************************************/
+static int compare_ranges(const void *a, const void *b)
+{
+        const Profile_range *x = a;
+        const Profile_range *y = b;
+        if (x->samples != y->samples) {
+                return x->samples < y->samples ? 1 : -1;
+        }
+        if (x->program != y->program) {
+                return x->program < y->program ? -1 : 1;
+        }
+        return (x->range > y->range) - (x->range < y->range);
+}
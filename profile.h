@@ -0,0 +1,35 @@
+/**************************************************************
+ *
+ *                     profile.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Declarations for the sampling profiler used by --profile.
+ *              While it runs, the profiling engine publishes the program
+ *              counter and the segment the 0 segment was loaded from in two
+ *              globals, which a SIGPROF handler samples on an ITIMER_PROF
+ *              timer.
+ * 
+ **************************************************************/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Program counter of the instruction being executed, and the ID of the
+ * segment the last LOADP that replaced the 0 segment loaded (0 before any
+ * did), as last published by the engine */
+extern volatile uint32_t profile_pc;
+extern volatile uint32_t profile_program;
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern void start_profile(void);
+extern void stop_profile(FILE *fp);
+
+#endif
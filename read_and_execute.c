@@ -17,24 +17,21 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <assert.h>
+#include <sys/mman.h>
 #include "read_and_execute.h"
 #include "segment.h"
 #include "bitpack.h"
 #include "operations.h"
+#include "threaded_execute.h"
+#include "jit_execute.h"
+#include "load_words.h"
+#include "profile.h"
+#include "checkpoint.h"
+#include "image.h"
 
 typedef uint32_t Um_instruction; /* private abbreviation */
 
-/********** Um_opcode ********
- * 
- * Enum to hold all the possible opcodes for the instructions that can be 
- * executed by the Universal Machine.
- *
- *******************/
-typedef enum Um_opcode {
-        CMOV = 0, SLOAD, SSTORE, ADD, MUL, DIV,
-        NAND, HALT, MAP, UNMAP, OUT, IN, LOADP, LV
-} Um_opcode;
-
 /****************** um_driver *******************
  * 
  * Function to call the appropriate functions to read the instructions from the
@@ -42,36 +39,119 @@ typedef enum Um_opcode {
  * in the address space. 
  *
  * Parameters:
- *            FILE *fp: pointer to the file that holds the instructions
+ *            FILE *fp: pointer to the file that holds the instructions, or
+ *                      NULL when restoring a checkpoint or loading an image
  *     size_t num_inst: number of instructions in the file
+ *  Um_options options: the engine to run the instructions with and when
+ *                      their output is written
  * Returns:
- *        None.
+ *      EXIT_SUCCESS, or EXIT_FAILURE if the program failed
  * Expects:
- *      The file pointer is not NULL.
+ *      The file pointer is not NULL unless options.restore or
+ *      options.image is set.
  *      The number of instructions is greater than 0.
  * Notes: 
- *      The function initializes 8 registers and sets each to 0. It then 
- *      creates a new address space, reads the instructions from the file into
- *      the address space, executes each instruction, and frees all the 
- *      segments in the address space.
+ *      The function creates a new machine, whose 8 registers are set to 0,
+ *      reads the instructions from the file into its address space, executes
+ *      each instruction, and frees the machine, which writes out any output
+ *      still buffered and frees all the segments in the address space.
+ *      When restoring, the registers, program counter and segments come
+ *      from the checkpoint instead, and when loading an image the 0 segment
+ *      and its decoded records are mapped from the image; either way
+ *      num_inst is ignored.
  * 
  ********************************************/
-extern void um_driver(FILE *fp, size_t num_inst) 
+extern int um_driver(FILE *fp, size_t num_inst, Um_options options) 
 {
-        /* Initialize 8 registers and set each to 0 */
-        uint32_t registers[8] = { 0 };
+        /* Create a new machine with its registers and address space */
+        Machine vm = new_machine(options.output_mode);
+
+        /* Read instructions from file into address space, or start from
+         * the state saved in a checkpoint, or map them from an image */
+        if (options.restore != NULL) {
+                num_inst = restore_checkpoint(options.restore, vm);
+        } else if (options.image != NULL) {
+                num_inst = load_image(options.image, vm->space);
+        } else {
+                read_instructions(fp, vm->space, num_inst);
+        }
 
-        /* Create a new address space */
-        Address_space space = new_address_space();
+        /* Start the sampling profiler if it was asked for */
+        if (options.profile) {
+                vm->profiling = true;
+                start_profile();
+        }
 
-        /* Read instructions from file into address space */
-        read_instructions(fp, space, num_inst);
+        /* Let the engine write checkpoints if they were asked for */
+        if (options.checkpoint != NULL) {
+                start_checkpoints(options.checkpoint, options.checkpoint_at);
+        }
 
-        /* Execute each instructions */
-        execute_instructions(space, num_inst, registers);
+        /* Keep counters if they were asked for */
+        if (options.stats || options.report_fusion) {
+                vm->stats = new_stats(options.stats, options.report_fusion);
+        }
+
+        /* Execute each instructions until the program halts or runs off
+         * the end of the 0 segment */
+        run_machine(vm, num_inst, options);
+
+        /* Flush the output and free all the segments in the address space,
+         * then report a failure after the output that came before it */
+        const char *failure = vm->failure;
+        uint32_t failed_at = vm->prog_counter;
+        free_machine(&vm);
+        if (failure != NULL) {
+                fprintf(stderr, "Error: %s at instruction %u\n", failure,
+                        failed_at);
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
 
-        /* Free all the segments in the address space */
-        free_all_segments(space);
+/****************** run_machine *******************
+ * 
+ * Executes the instructions in the 0 segment of a machine with the
+ * requested engine, or with the counting, checkpointing or profiling
+ * engine if counters, checkpoints or a profile were asked for.
+ *
+ * Parameters:
+ *          Machine vm: the machine, loaded and ready to run
+ *     size_t num_inst: number of instructions in the 0 segment
+ *  Um_options options: the engine to run the instructions with
+ * Returns:
+ *        None.
+ * Expects:
+ *      vm is not NULL. The machine keeps counters if vm->stats is set, and
+ *      start_checkpoints and start_profile were called if options ask for
+ *      checkpoints or a profile.
+ * Notes: 
+ *      Returns when the program halts, runs off the end of the 0 segment,
+ *      or fails, leaving the machine for the caller to free. The threaded
+ *      engines record why a program failed in vm->failure; with
+ *      options.trusted the threaded engine makes no checks at all. Counters,
+ *      checkpoints and profiles come from copies of the checked threaded
+ *      engine and take precedence over options.engine and options.trusted,
+ *      which um refuses to combine with --profile or --checkpoint.
+ * 
+ ********************************************/
+extern void run_machine(Machine vm, size_t num_inst, Um_options options)
+{
+        if (vm->stats != NULL) {
+                execute_threaded_counting(vm, num_inst);
+        } else if (options.checkpoint != NULL) {
+                execute_threaded_checkpointing(vm, num_inst);
+        } else if (options.profile) {
+                execute_threaded_profiling(vm, num_inst);
+        } else if (options.engine == THREADED_ENGINE && options.trusted) {
+                execute_threaded_trusted(vm, num_inst);
+        } else if (options.engine == THREADED_ENGINE) {
+                execute_threaded(vm, num_inst);
+        } else if (options.engine == JIT_ENGINE) {
+                execute_jit(vm, num_inst);
+        } else {
+                execute_instructions(vm, num_inst);
+        }
 }
 
 /*************** read_instructions ***************
@@ -87,48 +167,51 @@ extern void um_driver(FILE *fp, size_t num_inst)
  * Returns:
  *      None.
  * Expects:
- *      None
+ *      The file holds at least num_inst big-endian words, throws a CRE if
+ *      it cannot be read.
  * Notes: 
  *      The function first initializes the 0 segment with the known length.
- *      It procedes to get each 32-bit instruction with getc and bitpacking.
- *      Finally, it populates the zero segment and closes the file upon
- *      finishing.
+ *      It then maps the whole file into memory and converts its big-endian
+ *      words to host words in bulk, straight into the zero segment. Files
+ *      that cannot be mapped, such as pipes, are read into the zero segment
+ *      with fread and converted in place. Finally, it closes the file and
+ *      decodes the zero segment for the execution engines.
  * 
  ********************************************/
 extern void read_instructions(FILE *fp, Address_space space, size_t num_inst) 
 {
-        /* Initialize variables to hold instruction and character inputted */
-        Um_instruction word;
-        int c;
-
         /* Create a new segment in the file space (0 segment) */
         map_segment(space, NULL, 0, 0, num_inst, true);
 
-        /* Read the first character from the file */
-        c = getc(fp);
-
-        /* Read the intstructions from the file into 0 segment */
-        for (size_t inst_count = 0; inst_count < num_inst; inst_count++) {
-                /* Initialize word to 0 to start */
-                word = 0;
-
-                /* Read in the 32-bit word from the input file */
-                for (int bit = sizeof(Um_instruction) - 1; bit >= 0; bit--) {
-                        /* Add the character to the word */
-                        word = (Um_instruction)Bitpack_newu((uint64_t)word, 8,
-                                                       (bit * 8), (uint64_t)c);
-
-                        /* Read the next character from the file */
-                        c = getc(fp);
+        if (num_inst > 0) {
+                /* The words of a segment are contiguous, so the whole
+                 * program is converted into the 0 segment at once */
+                uint32_t *words = word_at(space, 0, 0);
+                size_t num_bytes = num_inst * sizeof(Um_instruction);
+
+                /* Map the file and convert its words into the 0 segment */
+                void *image = mmap(NULL, num_bytes, PROT_READ, MAP_PRIVATE,
+                                   fileno(fp), 0);
+                if (image != MAP_FAILED) {
+                        madvise(image, num_bytes, MADV_SEQUENTIAL);
+                        load_big_endian(words, image, num_inst);
+                        munmap(image, num_bytes);
+                } else {
+                        /* Read the file into the 0 segment and convert the
+                         * words where they are */
+                        size_t num_read = fread(words, sizeof(Um_instruction),
+                                                num_inst, fp);
+                        assert(num_read == num_inst);
+                        load_big_endian(words, (unsigned char *)words,
+                                        num_inst);
                 }
-
-                /* Place the word in the 0 segment at the index of the 
-                 * instruction the program is at */
-                uint32_t *word_location = word_at(space, 0, inst_count);
-                *word_location = word;
         }
+
         /* After reading in the instructions, close the file */
         fclose(fp);
+
+        /* Decode the 0 segment once so execution never unpacks a word */
+        decode_program(space);
 }
 
 /*************** execute_instructions ***************
@@ -137,11 +220,10 @@ extern void read_instructions(FILE *fp, Address_space space, size_t num_inst)
  * given address space.
  *
  * Parameters:
- *      Address_space space: an Address_space object in which the 0 segment
- *                           will be mapped.
- *      size_t num_inst:     number of instructions in the file
- *      uint32_t *registers: a pointer to the array of unsigned 32-bit integers
- *                           that contain registers 0 - 7.
+ *      Machine vm:      the machine whose address space holds the
+ *                       instructions in the 0 segment and whose registers
+ *                       they operate on.
+ *      size_t num_inst: number of instructions in the 0 segment
  * Returns:
  *      None.
  * Expects:
@@ -149,38 +231,47 @@ extern void read_instructions(FILE *fp, Address_space space, size_t num_inst)
  * Notes: 
  *      The function first initializes the program counter to point to the
  *      first instruction in the 0 segment and then iterates through. For
- *      each instruction, the function gets the register indices and then
- *      calls a function corresponding to the instruction's opcode.
+ *      each instruction, the function gets the register indices from the
+ *      decoded copy of the 0 segment and then calls a function corresponding
+ *      to the instruction's opcode.
  * 
  ********************************************/
-extern void execute_instructions(Address_space space, size_t num_inst, 
-                                 uint32_t *registers)
+extern void execute_instructions(Machine vm, size_t num_inst)
 {
-        /* Initialize program counter */
-        size_t prog_counter = 0;
+        /* Get the address space and registers of the machine */
+        Address_space space = vm->space;
+        uint32_t *registers = vm->registers;
+
+        /* Start at the machine's program counter, 0 unless the machine was
+         * restored from a checkpoint */
+        size_t prog_counter = vm->prog_counter;
 
         /* Initialize boolean to check if last instruction was a LOADP so that
          * the program does not increment new prog_counter at end of loop */
         bool last_loadp = false;
 
+        /* Get the decoded copy of the 0 segment */
+        Um_decoded *program = decoded_program(space);
+
         /* Execute instructions until program counter reaches the end of the 
          * number of instructions there are */
         while (prog_counter < num_inst) {
-                /* Get instruction from index of prog_counter from 0 segment */
-                uint32_t *instruction = word_at(space, 0, prog_counter);
+                /* Get decoded instruction at prog_counter in the 0 segment */
+                Um_decoded *instruction = &program[prog_counter];
+                Um_decoded *next;
 
                 /* Fetch register indices from instruction */
-                uint32_t a_index = get_A(*instruction);
-                uint32_t b_index = get_B(*instruction);
-                uint32_t c_index = get_C(*instruction);
-                uint32_t a_lv_index = get_A_lv(*instruction);
-                uint32_t value = get_val(*instruction);
+                uint32_t a_index = instruction->a;
+                uint32_t b_index = instruction->b;
+                uint32_t c_index = instruction->c;
+                uint32_t a_lv_index = instruction->a;
+                uint32_t value = instruction->val;
 
                 /* Reset boolean to false */
                 last_loadp = false;
 
                 /* Execute instruction based on the opcode of instruction */
-                switch(get_op(*instruction))
+                switch(instruction->op)
                 {
                         case CMOV:
                                 /* Call conditional move function */
@@ -220,9 +311,9 @@ extern void execute_instructions(Address_space space, size_t num_inst,
                                 break;
 
                         case HALT:
-                                /* Call halt function */
-                                halt(space);
-                                break;
+                                /* Call halt function and stop */
+                                halt(vm);
+                                return;
 
                         case MAP:
                                 /* Call map segment function */
@@ -237,12 +328,12 @@ extern void execute_instructions(Address_space space, size_t num_inst,
 
                         case OUT:
                                 /* Call output function */
-                                output(registers, c_index);
+                                output(vm->out, registers, c_index);
                                 break;
 
                         case IN:
                                 /* Call input function */
-                                input(registers, c_index);
+                                input(vm->in, vm->out, registers, c_index);
                                 break;
 
                         case LOADP:
@@ -250,6 +341,10 @@ extern void execute_instructions(Address_space space, size_t num_inst,
                                 load_program(space, registers, b_index, 
                                             c_index, &prog_counter, &num_inst);
 
+                                /* The 0 segment may have been replaced, so
+                                 * fetch its decoded copy again */
+                                program = decoded_program(space);
+
                                 /* Set bool to true to indicate LOAP was 
                                  * last operation executed */
                                 last_loadp = true;
@@ -260,6 +355,42 @@ extern void execute_instructions(Address_space space, size_t num_inst,
                                 load_value(registers, a_lv_index, value);
                                 break;
                         
+                        case FUSED_SLOAD_ADD:
+                                /* Call segment load and add functions for
+                                 * the pair, then skip the add */
+                                seg_load(space, registers, a_index, b_index,
+                                         c_index);
+                                next = &program[++prog_counter];
+                                add(registers, next->a, next->b, next->c);
+                                break;
+
+                        case FUSED_NAND_NAND:
+                                /* Call nand function for both of the pair */
+                                nand(registers, a_index, b_index, c_index);
+                                next = &program[++prog_counter];
+                                nand(registers, next->a, next->b, next->c);
+                                break;
+
+                        case FUSED_LV_ADD:
+                                /* Call load value and add functions for the
+                                 * pair */
+                                load_value(registers, a_lv_index, value);
+                                next = &program[++prog_counter];
+                                add(registers, next->a, next->b, next->c);
+                                break;
+
+                        case FUSED_LV_LOADP:
+                                /* Call load value function, then jump if
+                                 * the LOADP stays in the 0 segment. A LOADP
+                                 * of another segment runs on its own next */
+                                load_value(registers, a_lv_index, value);
+                                next = &program[++prog_counter];
+                                if (registers[next->b] == 0) {
+                                        prog_counter = registers[next->c];
+                                }
+                                last_loadp = true;
+                                break;
+
                         default:
                                 exit(EXIT_FAILURE);
                                 break;
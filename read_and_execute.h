@@ -17,14 +17,62 @@
 #define READ_AND_EXECUTE_H
 
 #include "segment.h"
+#include "decode.h"
+#include "machine.h"
+#include "output_buffer.h"
+
+/********** Um_engine ********
+ * 
+ * Enum to hold the execution engines that can run the instructions in the 0
+ * segment: the original switch-based loop, the direct-threaded engine, and
+ * the tiered engine that compiles hot blocks to native code.
+ *
+ *******************/
+typedef enum Um_engine {
+        SWITCH_ENGINE = 0, THREADED_ENGINE, JIT_ENGINE
+} Um_engine;
+
+/* Engine used when none is requested on the command line. Building with
+ * -DUM_SWITCH_ENGINE makes the switch-based loop the default, and building
+ * with -DUM_JIT_ENGINE makes the tiered engine the default */
+#if defined(UM_SWITCH_ENGINE)
+#define DEFAULT_ENGINE SWITCH_ENGINE
+#elif defined(UM_JIT_ENGINE)
+#define DEFAULT_ENGINE JIT_ENGINE
+#else
+#define DEFAULT_ENGINE THREADED_ENGINE
+#endif
+
+/********** Um_options ********
+ * 
+ * Struct to hold the choices made on the command line about how a program
+ * is run.
+ *
+ *******************/
+typedef struct Um_options {
+        Um_engine engine;        /* engine that executes the instructions */
+        Output_mode output_mode; /* when the program's output is written */
+        bool stats;              /* print counters as JSON on stderr */
+        bool report_fusion;      /* print fusion counts on stderr */
+        bool profile;            /* print a sampled PC profile on stderr */
+        const char *checkpoint;  /* file checkpoints are written to, or NULL */
+        uint64_t checkpoint_at;  /* instructions before the checkpoint, or 0
+                                  * to write one only on SIGUSR1 */
+        const char *restore;     /* checkpoint to start from, or NULL */
+        const char *image;       /* program image to run, or NULL */
+        bool trusted;            /* run without checks on the program */
+        uint64_t quantum;        /* instructions per turn when batch jobs are
+                                  * interleaved, or 0 to run them on
+                                  * worker threads */
+} Um_options;
 
 /*****************************************************************
  *                  Program Function Declarations
  *****************************************************************/
-extern void um_driver(FILE *fp, size_t num_inst);
+extern int um_driver(FILE *fp, size_t num_inst, Um_options options);
+extern void run_machine(Machine vm, size_t num_inst, Um_options options);
 extern void read_instructions(FILE *fp, Address_space space, size_t num_inst);
-extern void execute_instructions(Address_space space, size_t num_inst,
-                                                          uint32_t *registers);
+extern void execute_instructions(Machine vm, size_t num_inst);
 
 /*****************************************************************
  *                  Getter Function Declarations
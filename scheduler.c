@@ -0,0 +1,620 @@
+/**************************************************************
+ *
+ *                     scheduler.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of the Scheduler ADT. Machines wait their
+ *              turn in a ring of ready machines. Each turn runs one machine
+ *              on the scheduled threaded engine, which returns once the
+ *              quantum is used up, the machine stops, or it reaches an
+ *              input or output instruction that would wait. The input and
+ *              output of every machine are made non-blocking, and an epoll
+ *              instance watches the descriptors machines wait on: a
+ *              machine waiting for input is set aside until its input is
+ *              readable, and output its descriptor would not take is
+ *              written whenever the descriptor becomes writable, while the
+ *              machine runs on. A machine that stops is only handed back
+ *              once all of its output is written. After each round of
+ *              turns the events are collected without blocking, and when no
+ *              machine can run the scheduler sleeps in epoll_wait.
+ *              Machines that could not start when they were scheduled
+ *              are tried again every few milliseconds, and a machine
+ *              reading a FIFO sleeps until it is readable before its
+ *              first turn.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include "scheduler.h"
+#include "threaded_execute.h"
+#include "segment_private.h"
+#include "mem.h"
+#include "assert.h"
+
+/* Most events taken from epoll at once */
+#define MAX_EVENTS 256
+
+/* Milliseconds between tries at starting the machines that could not */
+#define START_INTERVAL 10
+
+/********** Task ********
+ *
+ * One machine in the scheduler, what it has used, and which of its
+ * descriptors are watched. Each descriptor is added to the epoll instance
+ * the first time it is watched, and is watched for one event at a time.
+ *
+ *******************/
+typedef struct Task {
+        Machine vm;           /* the machine, or NULL until it starts
+                               * and once it stopped */
+        Machine_start start;  /* tries to start it, or NULL once it has */
+        void *cl;             /* closure handed back when it stops */
+        double seconds;       /* time spent running its turns */
+        bool input_added;     /* whether its input is in the epoll set */
+        bool output_added;    /* whether its output is in the epoll set */
+        bool watching_input;  /* whether its input is watched */
+        bool watching_output; /* whether its output is watched */
+} Task;
+
+/********** Scheduler ********
+ *
+ * Struct to hold the machines, the ring of machines that can run, and the
+ * epoll instance. Machines are named in the ring and in events by their
+ * place in tasks.
+ *
+ *******************/
+struct Scheduler {
+        uint64_t quantum;        /* instructions in a turn */
+        Machine_stopped stopped; /* called as each machine stops */
+        Task *tasks;             /* every machine scheduled */
+        size_t num_tasks;        /* number of machines scheduled */
+        size_t capacity;         /* number of tasks there is room for */
+        size_t *ready;           /* ring of machines that can run */
+        size_t ready_head;       /* place in ready of the next to run */
+        size_t num_ready;        /* number of machines that can run */
+        size_t num_waiting;      /* machines waiting for their I/O */
+        size_t num_watches;      /* descriptors watched */
+        size_t num_starting;     /* machines that have not started */
+        struct timespec started; /* when starting them was last tried */
+        int epoll_fd;            /* the epoll instance */
+};
+
+/* Declarations for the helpers */
+static Task *add_task(Scheduler scheduler, void *cl);
+static void set_up(Task *task, Machine vm, uint64_t quantum);
+static void begin(Scheduler scheduler, size_t index);
+static void start_machines(Scheduler scheduler);
+static double elapsed_seconds(const struct timespec *start);
+static void run_turn(Task *task);
+static void end_turn(Scheduler scheduler, size_t index);
+static void make_ready(Scheduler scheduler, size_t index);
+static void finish(Scheduler scheduler, size_t index);
+static bool watch(Scheduler scheduler, size_t index, bool output);
+static void wait_for_io(Scheduler scheduler, int timeout);
+static void output_written(Scheduler scheduler, size_t index);
+static void set_nonblocking(int fd);
+
+/**************** new_scheduler ****************
+ *
+ * Creates a new scheduler with no machines.
+ *
+ * Parameters:
+ *      uint64_t quantum:        instructions each machine runs in a turn
+ *      Machine_stopped stopped: function called as each machine stops
+ * Returns:
+ *      the new Scheduler
+ * Expects:
+ *      quantum is greater than 0 and stopped is not NULL. The client frees
+ *      the scheduler with free_scheduler.
+ *
+ ********************************************/
+extern Scheduler new_scheduler(uint64_t quantum, Machine_stopped stopped)
+{
+        assert(quantum > 0 && stopped != NULL);
+        Scheduler scheduler;
+        NEW(scheduler);
+        scheduler->quantum = quantum;
+        scheduler->stopped = stopped;
+        scheduler->tasks = NULL;
+        scheduler->num_tasks = 0;
+        scheduler->capacity = 0;
+        scheduler->ready = NULL;
+        scheduler->ready_head = 0;
+        scheduler->num_ready = 0;
+        scheduler->num_waiting = 0;
+        scheduler->num_watches = 0;
+        scheduler->num_starting = 0;
+        scheduler->epoll_fd = -1;
+        return scheduler;
+}
+
+/**************** schedule_machine ****************
+ *
+ * Adds a machine to those the scheduler runs.
+ *
+ * Parameters:
+ *      Scheduler scheduler: the scheduler
+ *      Machine vm:          a machine with its program loaded, which has
+ *                           not run yet
+ *      void *cl:            closure passed to the stopped function along
+ *                           with the machine
+ * Returns:
+ *      None
+ * Expects:
+ *      scheduler and vm are not NULL and the scheduler is not running.
+ * Notes:
+ *      The machine's input and output descriptors are made non-blocking,
+ *      which holds for every other descriptor open on the same file.
+ *
+ ********************************************/
+extern void schedule_machine(Scheduler scheduler, Machine vm, void *cl)
+{
+        assert(scheduler != NULL && vm != NULL);
+        set_up(add_task(scheduler, cl), vm, scheduler->quantum);
+}
+
+/**************** schedule_start ****************
+ *
+ * Adds a machine that cannot start yet to those the scheduler runs, such
+ * as one whose output is a FIFO nobody has opened for reading.
+ *
+ * Parameters:
+ *      Scheduler scheduler: the scheduler
+ *      Machine_start start: function called from the scheduler's loop
+ *                           until the machine has started, or will never
+ *      void *cl:            closure passed to start, and to the stopped
+ *                           function along with the machine
+ * Returns:
+ *      None
+ * Expects:
+ *      scheduler and start are not NULL and the scheduler is not running.
+ * Notes:
+ *      start is called every few milliseconds, while the machines that
+ *      have started run on. The machine it starts is taken as
+ *      schedule_machine takes one, and a machine that never starts is not
+ *      handed to the stopped function.
+ *
+ ********************************************/
+extern void schedule_start(Scheduler scheduler, Machine_start start,
+                           void *cl)
+{
+        assert(scheduler != NULL && start != NULL);
+        Task *task = add_task(scheduler, cl);
+        task->start = start;
+        scheduler->num_starting++;
+}
+
+/**************** run_scheduler ****************
+ *
+ * Runs every scheduled machine until it stops, calling the stopped
+ * function for each one as it does.
+ *
+ * Parameters:
+ *      Scheduler scheduler: the scheduler
+ * Returns:
+ *      None
+ * Expects:
+ *      scheduler is not NULL. Exits with an error message if an epoll
+ *      instance cannot be created.
+ * Notes:
+ *      Every machine that can run gets one turn per round, in the order
+ *      they were scheduled. Machines that wait for input or output keep no
+ *      place in the ring until they can go on, and then take the next turn
+ *      at the back of it.
+ *
+ ********************************************/
+extern void run_scheduler(Scheduler scheduler)
+{
+        assert(scheduler != NULL);
+        size_t num_tasks = scheduler->num_tasks;
+        if (num_tasks == 0) {
+                return;
+        }
+
+        scheduler->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (scheduler->epoll_fd < 0) {
+                perror("epoll_create1");
+                exit(EXIT_FAILURE);
+        }
+
+        /* Every machine is in the ring at most once, so the ring needs no
+         * more room than there are machines */
+        scheduler->ready = CALLOC((long)num_tasks, sizeof(size_t));
+        scheduler->ready_head = 0;
+        scheduler->num_ready = 0;
+        for (size_t i = 0; i < num_tasks; i++) {
+                if (scheduler->tasks[i].vm != NULL) {
+                        begin(scheduler, i);
+                }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &scheduler->started);
+        start_machines(scheduler);
+
+        while (scheduler->num_ready > 0 || scheduler->num_waiting > 0 ||
+               scheduler->num_starting > 0) {
+                /* One turn for each machine that was ready at the start
+                 * of the round */
+                for (size_t turns = scheduler->num_ready; turns > 0;
+                     turns--) {
+                        size_t index = scheduler->ready[scheduler->ready_head];
+                        scheduler->ready_head = (scheduler->ready_head + 1) %
+                                                num_tasks;
+                        scheduler->num_ready--;
+                        run_turn(&scheduler->tasks[index]);
+                        end_turn(scheduler, index);
+                }
+
+                /* Sleep only when no machine can run, and no longer than
+                 * until the next try at starting machines */
+                if (scheduler->num_watches > 0 ||
+                    (scheduler->num_ready == 0 &&
+                     scheduler->num_starting > 0)) {
+                        int timeout = scheduler->num_ready > 0 ? 0 :
+                                      scheduler->num_starting > 0 ?
+                                      START_INTERVAL : -1;
+                        wait_for_io(scheduler, timeout);
+                }
+                if (scheduler->num_starting > 0 &&
+                    elapsed_seconds(&scheduler->started) * 1000 >=
+                    START_INTERVAL) {
+                        start_machines(scheduler);
+                }
+        }
+
+        close(scheduler->epoll_fd);
+        scheduler->epoll_fd = -1;
+        FREE(scheduler->ready);
+        scheduler->num_tasks = 0;
+}
+
+/**************** free_scheduler ****************
+ *
+ * Frees the given scheduler and sets the client's pointer to NULL. Machines
+ * that have not stopped are not freed.
+ *
+ * Parameters:
+ *      Scheduler *scheduler: pointer to the scheduler to free
+ * Returns:
+ *      None
+ * Expects:
+ *      scheduler and *scheduler are not NULL.
+ *
+ ********************************************/
+extern void free_scheduler(Scheduler *scheduler)
+{
+        assert(scheduler != NULL && *scheduler != NULL);
+        if ((*scheduler)->tasks != NULL) {
+                FREE((*scheduler)->tasks);
+        }
+        FREE(*scheduler);
+}
+
+/**************** add_task ****************
+ *
+ * Makes room for one more machine and returns its task, with nothing
+ * watched and neither a machine nor a way to start one.
+ *
+ ********************************************/
+static Task *add_task(Scheduler scheduler, void *cl)
+{
+        if (scheduler->num_tasks == scheduler->capacity) {
+                scheduler->capacity = scheduler->capacity == 0 ?
+                                      64 : scheduler->capacity * 2;
+                if (scheduler->tasks == NULL) {
+                        scheduler->tasks = ALLOC((long)scheduler->capacity *
+                                                 sizeof(Task));
+                } else {
+                        RESIZE(scheduler->tasks, (long)scheduler->capacity *
+                                                 sizeof(Task));
+                }
+        }
+
+        Task *task = &scheduler->tasks[scheduler->num_tasks++];
+        task->vm = NULL;
+        task->start = NULL;
+        task->cl = cl;
+        task->seconds = 0;
+        task->input_added = false;
+        task->output_added = false;
+        task->watching_input = false;
+        task->watching_output = false;
+        return task;
+}
+
+/**************** set_up ****************
+ *
+ * Gives a task its machine, whose input and output are made non-blocking,
+ * which holds for every other descriptor open on the same file.
+ *
+ ********************************************/
+static void set_up(Task *task, Machine vm, uint64_t quantum)
+{
+        set_nonblocking(input_fd(vm->in));
+        set_nonblocking(output_fd(vm->out));
+        vm->quantum = quantum;
+        vm->instructions = 0;
+        vm->state = MACHINE_READY;
+        task->vm = vm;
+}
+
+/**************** begin ****************
+ *
+ * Lets a machine that has not run yet take its first turn, once there is
+ * something to read if its input is a FIFO. A FIFO opened without waiting
+ * for a writer reads as ended until one connects, and it only becomes
+ * readable once the writer writes or goes away.
+ *
+ ********************************************/
+static void begin(Scheduler scheduler, size_t index)
+{
+        struct stat info;
+        int fd = input_fd(scheduler->tasks[index].vm->in);
+        if (fstat(fd, &info) == 0 && S_ISFIFO(info.st_mode) &&
+            watch(scheduler, index, false)) {
+                scheduler->num_waiting++;
+        } else {
+                make_ready(scheduler, index);
+        }
+}
+
+/**************** start_machines ****************
+ *
+ * Tries once more to start each machine that has not started, and lets
+ * those that do go on.
+ *
+ ********************************************/
+static void start_machines(Scheduler scheduler)
+{
+        for (size_t i = 0; i < scheduler->num_tasks; i++) {
+                Task *task = &scheduler->tasks[i];
+                Machine vm = NULL;
+                if (task->start == NULL || !task->start(task->cl, &vm)) {
+                        continue;
+                }
+                task->start = NULL;
+                scheduler->num_starting--;
+                if (vm != NULL) {
+                        set_up(task, vm, scheduler->quantum);
+                        begin(scheduler, i);
+                }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &scheduler->started);
+}
+
+/**************** elapsed_seconds ****************
+ *
+ * Returns the seconds since the given time on the monotonic clock.
+ *
+ ********************************************/
+static double elapsed_seconds(const struct timespec *start)
+{
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        return (end.tv_sec - start->tv_sec) +
+               (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**************** run_turn ****************
+ *
+ * Runs one turn of a machine, adding the time it took to the task.
+ *
+ ********************************************/
+static void run_turn(Task *task)
+{
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        /* A LOADP may have replaced the 0 segment since the last turn */
+        Machine vm = task->vm;
+        execute_threaded_scheduled(vm, vm->space->segments[0]->length);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        task->seconds += (end.tv_sec - start.tv_sec) +
+                         (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/**************** end_turn ****************
+ *
+ * Puts a machine whose turn has ended where its state says it belongs,
+ * and watches its output if the descriptor would not take all of it.
+ *
+ ********************************************/
+static void end_turn(Scheduler scheduler, size_t index)
+{
+        Task *task = &scheduler->tasks[index];
+        Machine vm = task->vm;
+
+        /* Show the output before waiting for input, as input does, and
+         * write out the output of a machine that stopped */
+        if (vm->state == MACHINE_BLOCKED || vm->state == MACHINE_STOPPED) {
+                flush_output(vm->out);
+        }
+        if (output_stalled(vm->out) && !task->watching_output &&
+            !watch(scheduler, index, true)) {
+                /* Only descriptors that never stall cannot be watched, so
+                 * this is not expected, but the output must not be lost */
+                drain_output(vm->out);
+        }
+
+        if (vm->state == MACHINE_READY) {
+                make_ready(scheduler, index);
+        } else if (vm->state == MACHINE_BLOCKED) {
+                /* Input that cannot be watched, such as a regular file,
+                 * is never waited for */
+                if (watch(scheduler, index, false)) {
+                        scheduler->num_waiting++;
+                } else {
+                        make_ready(scheduler, index);
+                }
+        } else if (output_stalled(vm->out)) {
+                /* Blocked on output, or stopped with output left */
+                scheduler->num_waiting++;
+        } else if (vm->state == MACHINE_BLOCKED_OUTPUT) {
+                make_ready(scheduler, index);
+        } else {
+                finish(scheduler, index);
+        }
+}
+
+/**************** make_ready ****************
+ *
+ * Puts a machine at the back of the ring of ready machines.
+ *
+ ********************************************/
+static void make_ready(Scheduler scheduler, size_t index)
+{
+        size_t back = (scheduler->ready_head + scheduler->num_ready) %
+                      scheduler->num_tasks;
+        scheduler->ready[back] = index;
+        scheduler->num_ready++;
+        scheduler->tasks[index].vm->state = MACHINE_READY;
+}
+
+/**************** finish ****************
+ *
+ * Hands a stopped machine, with all of its output written, back to the
+ * client, after taking its descriptors out of the epoll set so that they
+ * can be closed.
+ *
+ ********************************************/
+static void finish(Scheduler scheduler, size_t index)
+{
+        Task *task = &scheduler->tasks[index];
+        Machine vm = task->vm;
+        if (task->input_added) {
+                epoll_ctl(scheduler->epoll_fd, EPOLL_CTL_DEL,
+                          input_fd(vm->in), NULL);
+        }
+        if (task->output_added) {
+                epoll_ctl(scheduler->epoll_fd, EPOLL_CTL_DEL,
+                          output_fd(vm->out), NULL);
+        }
+        scheduler->num_watches -= task->watching_input +
+                                  task->watching_output;
+        task->vm = NULL;
+        scheduler->stopped(vm, task->seconds, task->cl);
+}
+
+/**************** watch ****************
+ *
+ * Watches a machine's input for something to read, or its output for room
+ * to write, for one event.
+ *
+ * Parameters:
+ *      Scheduler scheduler: the scheduler
+ *      size_t index:        the machine's place in tasks
+ *      bool output:         whether to watch the output or the input
+ * Returns:
+ *      true, or false if the descriptor cannot be watched, as regular
+ *      files cannot
+ *
+ ********************************************/
+static bool watch(Scheduler scheduler, size_t index, bool output)
+{
+        Task *task = &scheduler->tasks[index];
+        bool *added = output ? &task->output_added : &task->input_added;
+        bool *watching = output ? &task->watching_output :
+                                  &task->watching_input;
+        int fd = output ? output_fd(task->vm->out) : input_fd(task->vm->in);
+
+        /* The event names the machine and which descriptor it is for */
+        struct epoll_event event;
+        event.events = (output ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+        event.data.u64 = (uint64_t)index * 2 + output;
+        if (epoll_ctl(scheduler->epoll_fd,
+                      *added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd,
+                      &event) != 0) {
+                return false;
+        }
+        *added = true;
+        *watching = true;
+        scheduler->num_watches++;
+        return true;
+}
+
+/**************** wait_for_io ****************
+ *
+ * Collects the events on watched descriptors, waiting up to timeout
+ * milliseconds (-1 for as long as it takes) for the first, and lets the
+ * machines they concern go on. Input that has ended also wakes a
+ * machine, which then reads EOF.
+ *
+ ********************************************/
+static void wait_for_io(Scheduler scheduler, int timeout)
+{
+        struct epoll_event events[MAX_EVENTS];
+        int num_events = epoll_wait(scheduler->epoll_fd, events, MAX_EVENTS,
+                                    timeout);
+        if (num_events < 0 && errno != EINTR) {
+                perror("epoll_wait");
+                exit(EXIT_FAILURE);
+        }
+
+        for (int i = 0; i < num_events; i++) {
+                size_t index = (size_t)(events[i].data.u64 / 2);
+                bool output = events[i].data.u64 % 2 == 1;
+                Task *task = &scheduler->tasks[index];
+                scheduler->num_watches--;
+                if (output) {
+                        task->watching_output = false;
+                        output_written(scheduler, index);
+                } else {
+                        task->watching_input = false;
+                        scheduler->num_waiting--;
+                        make_ready(scheduler, index);
+                }
+        }
+}
+
+/**************** output_written ****************
+ *
+ * Writes more of a machine's output now that its descriptor can take
+ * some, and lets the machine go on if it was waiting for that.
+ *
+ ********************************************/
+static void output_written(Scheduler scheduler, size_t index)
+{
+        Task *task = &scheduler->tasks[index];
+        Machine vm = task->vm;
+        flush_output(vm->out);
+        if (output_stalled(vm->out)) {
+                if (!watch(scheduler, index, true)) {
+                        drain_output(vm->out);
+                }
+        }
+        if (output_stalled(vm->out)) {
+                return;
+        }
+
+        if (vm->state == MACHINE_BLOCKED_OUTPUT) {
+                scheduler->num_waiting--;
+                make_ready(scheduler, index);
+        } else if (vm->state == MACHINE_STOPPED) {
+                scheduler->num_waiting--;
+                finish(scheduler, index);
+        }
+}
+
+/**************** set_nonblocking ****************
+ *
+ * Makes reads and writes on a file descriptor return instead of waiting.
+ *
+ ********************************************/
+static void set_nonblocking(int fd)
+{
+        int flags = fcntl(fd, F_GETFL);
+        if (flags >= 0 && (flags & O_NONBLOCK) == 0) {
+                fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        }
+}
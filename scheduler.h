@@ -0,0 +1,52 @@
+/**************************************************************
+ *
+ *                     scheduler.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Function declarations for the Scheduler ADT, which runs
+ *              many machines on the calling thread by giving each ready
+ *              machine a turn of a fixed number of instructions in round
+ *              robin order, and setting aside the machines that wait for
+ *              input, or for their output to be written, until their
+ *              descriptors are ready. Machines whose files cannot be
+ *              opened yet are started from the loop once they can be.
+ *
+ **************************************************************/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "machine.h"
+
+/*****************************************************************
+ *                  Scheduler Declaration
+ *****************************************************************/
+typedef struct Scheduler *Scheduler;
+
+/* Called once for each machine when it stops, with the seconds it spent
+ * running and the closure it was scheduled with. The machine belongs to
+ * the callback from then on */
+typedef void (*Machine_stopped)(Machine vm, double seconds, void *cl);
+
+/* Called from the scheduler's loop, with the closure it was scheduled
+ * with, to start a machine that could not start when it was scheduled.
+ * Returns false to be called again later, or true once it is done, with
+ * *vm set to the machine, or to NULL if it will never start */
+typedef bool (*Machine_start)(void *cl, Machine *vm);
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern Scheduler new_scheduler(uint64_t quantum, Machine_stopped stopped);
+extern void schedule_machine(Scheduler scheduler, Machine vm, void *cl);
+extern void schedule_start(Scheduler scheduler, Machine_start start,
+                           void *cl);
+extern void run_scheduler(Scheduler scheduler);
+extern void free_scheduler(Scheduler *scheduler);
+
+#endif
@@ -0,0 +1,404 @@
+/**************************************************************
+ *
+ *                     segbench.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Microbenchmarks for the Address_space ADT, linked directly
+ *              against segment.o and operations.o so that segment.c can be
+ *              tuned without the noise of running whole programs. It times
+ *              map/unmap churn at several segment lengths, with and without
+ *              the pool of recycled segments, sequential and random word_at
+ *              accesses, load_program at several 0 segment lengths, and
+ *              free_all_segments with millions of live segments. Each line
+ *              reports the nanoseconds and the allocations per operation.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "segment.h"
+#include "operations.h"
+
+/* Live segments kept by the churn benchmark, and the longest segment, in
+ * words, it maps before the number of operations stops shrinking */
+#define CHURN_LIVE 64
+#define CHURN_WORDS (1 << 26)
+
+/* Shape of the word_at benchmarks: one long segment for the sequential
+ * walk, and many short segments for the random accesses */
+#define SEQUENTIAL_LENGTH (1 << 22)
+#define RANDOM_SEGMENTS 4096
+#define RANDOM_LENGTH 256
+#define RANDOM_ACCESSES (1 << 22)
+
+/* Times the 0 segment is replaced in each load_program benchmark */
+#define LOADP_ROUNDS 64
+
+/* Registers used to pass lengths to and take IDs from map_segment */
+#define REG_ID 1
+#define REG_LENGTH 2
+
+/* Allocations made since the program started, counted by the wrappers
+ * below, which the linker substitutes for malloc, calloc, realloc and mmap
+ * with --wrap (see the segbench rule in the Makefile). The Hanson mem
+ * functions allocate through these, so every allocation segment.c makes is
+ * counted */
+static uint64_t allocations = 0;
+
+extern void *__real_malloc(size_t size);
+extern void *__real_calloc(size_t count, size_t size);
+extern void *__real_realloc(void *ptr, size_t size);
+extern void *__real_mmap(void *addr, size_t length, int prot, int flags,
+                         int fd, off_t offset);
+
+/* Sum of words read, so the compiler cannot drop the reads being timed */
+static volatile uint32_t sink;
+
+/* Declarations for the helpers */
+static double now(void);
+static void report(const char *name, uint64_t ops, double seconds,
+                   uint64_t allocs);
+static uint32_t next_random(uint32_t *state);
+static Address_space new_benchmark_space(uint32_t seg0_length);
+static void bench_churn(uint32_t length, bool pooled);
+static void bench_sequential(void);
+static void bench_random(void);
+static void bench_load_program(uint32_t length);
+static void bench_free_all(uint32_t num_segments);
+
+/****************** main *******************
+ *
+ * Runs every benchmark and prints one line for each.
+ *
+ * Parameters:
+ *         int argc:   number of arguments passed into the program
+ *      char *argv[]:  unused
+ * Returns:
+ *      EXIT_SUCCESS
+ * Expects:
+ *      No arguments.
+ *
+ ********************************************/
+int main(int argc, char *argv[])
+{
+        (void)argc;
+        (void)argv;
+
+        printf("%-34s %12s %12s %12s\n", "benchmark", "ops", "ns/op",
+               "allocs/op");
+
+        static const uint32_t churn_lengths[] = {
+                1, 16, 256, 4096, 65536, 262144
+        };
+        for (size_t i = 0; i < sizeof(churn_lengths) / sizeof(uint32_t);
+             i++) {
+                bench_churn(churn_lengths[i], true);
+                bench_churn(churn_lengths[i], false);
+        }
+
+        bench_sequential();
+        bench_random();
+
+        static const uint32_t program_lengths[] = { 1024, 65536, 1048576 };
+        for (size_t i = 0; i < sizeof(program_lengths) / sizeof(uint32_t);
+             i++) {
+                bench_load_program(program_lengths[i]);
+        }
+
+        bench_free_all(1000000);
+        bench_free_all(4000000);
+        return EXIT_SUCCESS;
+}
+
+/****************** bench_churn *******************
+ *
+ * Keeps CHURN_LIVE segments of the given length mapped and repeatedly
+ * unmaps one at random and maps a new one in its place. One operation is
+ * one unmap and one map.
+ *
+ * Parameters:
+ *      uint32_t length: length, in words, of every segment
+ *      bool pooled:     whether the pool of recycled segments is on
+ * Returns:
+ *      None
+ *
+ ********************************************/
+static void bench_churn(uint32_t length, bool pooled)
+{
+        Address_space space = new_benchmark_space(1);
+        if (!pooled) {
+                set_pool_limits(space, (Pool_limits){ 0, 0, 0 });
+        }
+
+        uint32_t regs[8] = { 0 };
+        uint32_t live[CHURN_LIVE];
+        regs[REG_LENGTH] = length;
+        for (int i = 0; i < CHURN_LIVE; i++) {
+                map_segment(space, regs, REG_ID, REG_LENGTH, 0, false);
+                live[i] = regs[REG_ID];
+        }
+
+        /* Do fewer operations on longer segments, since each map zeroes
+         * the whole segment */
+        uint64_t ops = CHURN_WORDS / length;
+        if (ops > (1 << 20)) {
+                ops = 1 << 20;
+        } else if (ops < (1 << 10)) {
+                ops = 1 << 10;
+        }
+
+        uint32_t state = 1;
+        uint64_t allocs = allocations;
+        double start = now();
+        for (uint64_t i = 0; i < ops; i++) {
+                uint32_t slot = next_random(&state) % CHURN_LIVE;
+                regs[REG_ID] = live[slot];
+                unmap_segment(space, regs, REG_ID);
+                map_segment(space, regs, REG_ID, REG_LENGTH, 0, false);
+                live[slot] = regs[REG_ID];
+        }
+        double seconds = now() - start;
+
+        char name[64];
+        snprintf(name, sizeof(name), "map/unmap %u words%s", length,
+                 pooled ? "" : " (no pool)");
+        report(name, ops, seconds, allocations - allocs);
+        free_all_segments(space);
+}
+
+/****************** bench_sequential *******************
+ *
+ * Reads every word of one long segment in order through word_at.
+ *
+ ********************************************/
+static void bench_sequential(void)
+{
+        Address_space space = new_benchmark_space(1);
+        uint32_t regs[8] = { 0 };
+        regs[REG_LENGTH] = SEQUENTIAL_LENGTH;
+        map_segment(space, regs, REG_ID, REG_LENGTH, 0, false);
+        uint32_t ID = regs[REG_ID];
+
+        uint32_t sum = 0;
+        uint64_t allocs = allocations;
+        double start = now();
+        for (uint32_t i = 0; i < SEQUENTIAL_LENGTH; i++) {
+                sum += *word_at(space, ID, i);
+        }
+        double seconds = now() - start;
+        sink = sum;
+
+        report("word_at sequential", SEQUENTIAL_LENGTH, seconds,
+               allocations - allocs);
+        free_all_segments(space);
+}
+
+/****************** bench_random *******************
+ *
+ * Reads words at random IDs and offsets among RANDOM_SEGMENTS short
+ * segments through word_at. The IDs and offsets are drawn before the clock
+ * starts.
+ *
+ ********************************************/
+static void bench_random(void)
+{
+        Address_space space = new_benchmark_space(1);
+        uint32_t regs[8] = { 0 };
+        regs[REG_LENGTH] = RANDOM_LENGTH;
+        for (int i = 0; i < RANDOM_SEGMENTS; i++) {
+                map_segment(space, regs, REG_ID, REG_LENGTH, 0, false);
+        }
+
+        uint32_t *IDs = malloc(RANDOM_ACCESSES * sizeof(uint32_t));
+        uint32_t *offsets = malloc(RANDOM_ACCESSES * sizeof(uint32_t));
+        uint32_t state = 1;
+        for (int i = 0; i < RANDOM_ACCESSES; i++) {
+                IDs[i] = 1 + next_random(&state) % RANDOM_SEGMENTS;
+                offsets[i] = next_random(&state) % RANDOM_LENGTH;
+        }
+
+        uint32_t sum = 0;
+        uint64_t allocs = allocations;
+        double start = now();
+        for (int i = 0; i < RANDOM_ACCESSES; i++) {
+                sum += *word_at(space, IDs[i], offsets[i]);
+        }
+        double seconds = now() - start;
+        sink = sum;
+
+        report("word_at random", RANDOM_ACCESSES, seconds,
+               allocations - allocs);
+        free(IDs);
+        free(offsets);
+        free_all_segments(space);
+}
+
+/****************** bench_load_program *******************
+ *
+ * Maps two segments of the given length and makes each of them the 0
+ * segment in turn with load_program, so every call replaces and decodes
+ * the 0 segment.
+ *
+ * Parameters:
+ *      uint32_t length: length, in words, of the programs loaded
+ * Returns:
+ *      None
+ *
+ ********************************************/
+static void bench_load_program(uint32_t length)
+{
+        Address_space space = new_benchmark_space(length);
+        uint32_t regs[8] = { 0 };
+        regs[REG_LENGTH] = length;
+        map_segment(space, regs, REG_ID, REG_LENGTH, 0, false);
+        uint32_t first = regs[REG_ID];
+        map_segment(space, regs, REG_ID, REG_LENGTH, 0, false);
+        uint32_t second = regs[REG_ID];
+
+        size_t prog_counter = 0;
+        size_t num_inst = length;
+        uint64_t allocs = allocations;
+        double start = now();
+        for (int i = 0; i < LOADP_ROUNDS; i++) {
+                regs[REG_ID] = i % 2 == 0 ? first : second;
+                load_program(space, regs, REG_ID, 0, &prog_counter,
+                             &num_inst);
+        }
+        double seconds = now() - start;
+
+        char name[64];
+        snprintf(name, sizeof(name), "load_program %u words", length);
+        report(name, LOADP_ROUNDS, seconds, allocations - allocs);
+        free_all_segments(space);
+}
+
+/****************** bench_free_all *******************
+ *
+ * Maps the given number of short segments and frees them all with one call
+ * to free_all_segments. One operation is one segment freed.
+ *
+ * Parameters:
+ *      uint32_t num_segments: number of live segments to free
+ * Returns:
+ *      None
+ *
+ ********************************************/
+static void bench_free_all(uint32_t num_segments)
+{
+        Address_space space = new_benchmark_space(1);
+        uint32_t regs[8] = { 0 };
+        uint32_t state = 1;
+        for (uint32_t i = 0; i < num_segments; i++) {
+                regs[REG_LENGTH] = 1 + next_random(&state) % 4;
+                map_segment(space, regs, REG_ID, REG_LENGTH, 0, false);
+        }
+
+        uint64_t allocs = allocations;
+        double start = now();
+        free_all_segments(space);
+        double seconds = now() - start;
+
+        char name[64];
+        snprintf(name, sizeof(name), "free_all_segments %u segs",
+                 num_segments);
+        report(name, num_segments, seconds, allocations - allocs);
+}
+
+/****************** new_benchmark_space *******************
+ *
+ * Creates an address space with a 0 segment of the given length mapped, as
+ * um does before running a program.
+ *
+ ********************************************/
+static Address_space new_benchmark_space(uint32_t seg0_length)
+{
+        Address_space space = new_address_space();
+        map_segment(space, NULL, 0, 0, seg0_length, true);
+        return space;
+}
+
+/****************** report *******************
+ *
+ * Prints one line of results.
+ *
+ * Parameters:
+ *      const char *name: what was timed
+ *      uint64_t ops:     number of operations timed
+ *      double seconds:   time the operations took
+ *      uint64_t allocs:  allocations made while they ran
+ * Returns:
+ *      None
+ *
+ ********************************************/
+static void report(const char *name, uint64_t ops, double seconds,
+                   uint64_t allocs)
+{
+        printf("%-34s %12llu %12.2f %12.4f\n", name, (unsigned long long)ops,
+               seconds * 1e9 / ops, (double)allocs / ops);
+}
+
+/****************** now *******************
+ *
+ * Returns the time of the monotonic clock, in seconds.
+ *
+ ********************************************/
+static double now(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/****************** next_random *******************
+ *
+ * Returns the next number from a 32-bit xorshift generator and advances
+ * its state, which must not be 0.
+ *
+ ********************************************/
+static uint32_t next_random(uint32_t *state)
+{
+        uint32_t x = *state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        *state = x;
+        return x;
+}
+
+/****************** __wrap_malloc *******************
+ *
+ * Counts an allocation and passes it on to malloc. __wrap_calloc,
+ * __wrap_realloc and __wrap_mmap do the same for their functions.
+ *
+ ********************************************/
+extern void *__wrap_malloc(size_t size)
+{
+        allocations++;
+        return __real_malloc(size);
+}
+
+extern void *__wrap_calloc(size_t count, size_t size)
+{
+        allocations++;
+        return __real_calloc(count, size);
+}
+
+extern void *__wrap_realloc(void *ptr, size_t size)
+{
+        allocations++;
+        return __real_realloc(ptr, size);
+}
+
+extern void *__wrap_mmap(void *addr, size_t length, int prot, int flags,
+                         int fd, off_t offset)
+{
+        allocations++;
+        return __real_mmap(addr, length, prot, flags, fd, offset);
+}
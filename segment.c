@@ -15,26 +15,47 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "segment.h"
-#include "seq.h"
-#include "uarray.h"
+#include "segment_private.h"
 #include "mem.h"
 #include "assert.h"
 
-/* Constant for the estimates number of element to create for the Seq_T */
-#define HINT 0
+/* Constant for the number of slots to allocate at first for the table of
+ * segments and the stack of unmapped IDs */
+#define HINT 16
 
-/********** Address_space ********
- * 
- * Struct to hold all the information needed to manage the segments in the
- * address space, including the sequence of segments in use, the number of
- * segments, and the sequence of unmapped segments.
- *
- *******************/
-struct Address_space {
-        Seq_T in_use; /* Seq_T of all segments that contain UArrays of words */
-        Seq_T unmapped; /* Seq_T of all of the unmapped segments */
-};
+/* Default caps on the pool of recycled segments: segments of up to 64K
+ * words, at most 4096 free segments per size class, and 16M words (64 MB)
+ * in total. Each can be overridden at build time or with set_pool_limits */
+#ifndef POOL_MAX_LENGTH
+#define POOL_MAX_LENGTH 65536
+#endif
+#ifndef POOL_MAX_PER_CLASS
+#define POOL_MAX_PER_CLASS 4096
+#endif
+#ifndef POOL_MAX_WORDS
+#define POOL_MAX_WORDS (16 * 1024 * 1024)
+#endif
+
+/* Default length, in words, from which a segment gets its own anonymous
+ * mmap instead of heap storage: 256K words (1 MB) */
+#ifndef MMAP_MIN_LENGTH
+#define MMAP_MIN_LENGTH (256 * 1024)
+#endif
+
+/* Declarations for the helpers that manage tables and recycled storage */
+static void *grow_table(void *table, uint32_t *capacity, size_t elem_size);
+static int size_class(uint32_t length);
+static Segment *take_segment(Address_space space, uint32_t length);
+static void release_segment(Address_space space, Segment *seg);
+static Segment *mmap_segment(uint32_t length);
+static void munmap_segment(Segment *seg);
+static void free_decoded(Address_space space);
+static bool pool_keeps_class(Segment_pool *pool, int k);
+static void trim_pool(Address_space space);
 
 /**************** new_address_space ****************
  * 
@@ -59,11 +80,63 @@ extern Address_space new_address_space()
         assert(space != NULL);
 
         /* Initalize the fields of the Address_space struct */
-        space->in_use = Seq_new(HINT);
-        space->unmapped = Seq_new(HINT);
+        space->segments = ALLOC(HINT * sizeof(Segment *));
+        space->num_segments = 0;
+        space->capacity = HINT;
+        space->unmapped = ALLOC(HINT * sizeof(uint32_t));
+        space->num_unmapped = 0;
+        space->unmapped_capacity = HINT;
+        space->decoded = NULL;
+        space->decoded_capacity = 0;
+        space->decoded_mapped = false;
+        space->stats.loadp_shared = 0;
+        space->stats.cow_copies = 0;
+        space->stats.pool_hits = 0;
+        space->stats.pool_misses = 0;
+        space->stats.mmap_segments = 0;
+        space->mmap_min_length = MMAP_MIN_LENGTH;
+
+        /* Start with an empty pool of recycled segments */
+        for (int k = 0; k < POOL_CLASSES; k++) {
+                space->pool.free[k] = NULL;
+                space->pool.count[k] = 0;
+                space->pool.slots[k] = 0;
+        }
+        space->pool.words = 0;
+        space->pool.limits.max_length = POOL_MAX_LENGTH;
+        space->pool.limits.max_per_class = POOL_MAX_PER_CLASS;
+        space->pool.limits.max_words = POOL_MAX_WORDS;
         return space;
 }
 
+/**************** allocate_segment ****************
+ * 
+ * Allocates a segment of the given length with every word set to 0, reusing
+ * the storage of an unmapped segment of the same size class if there is one.
+ * Long segments come zeroed from their own mmap and are not touched here.
+ *
+ * Parameters:
+ *      Address_space space: the address space the segment will belong to
+ *      uint32_t length:     number of words in the segment
+ * Returns:
+ *      a pointer to the new segment
+ * Expects:
+ *      Allocation of the segment is successful.
+ *      The segment is not shared yet. The client frees the segment with
+ *      free_segment once it is in the table of segments.
+ *
+ ********************************************/
+extern Segment *allocate_segment(Address_space space, uint32_t length)
+{
+        /* Take the storage and set all of its words to 0 in one pass,
+         * unless the kernel has already zeroed it */
+        Segment *seg = take_segment(space, length);
+        if (!seg->mmapped) {
+                memset(seg->words, 0, (size_t)length * sizeof(uint32_t));
+        }
+        return seg;
+}
+
 /**************** map_segment ****************
  * 
  * Maps a new segment with a number of words equal to the value in $r[C] or
@@ -94,49 +167,45 @@ extern void map_segment(Address_space space, uint32_t *regs, uint32_t b,
                         uint32_t c, int length, bool is_zero)
 {
         /* Get the length of the segment from register c */
+        uint32_t seg_length = (uint32_t)length;
         if (!is_zero) {
-                length = regs[c];
+                seg_length = regs[c];
         }
 
-        /* Create a new UArray of words */
-        UArray_T uarray = UArray_new(length, sizeof(uint32_t));
-        
-        /* Initalize all the words in the newly mapped segment to 0 */
-        for (int i = 0; i < length; i++) {
-                uint32_t *word = (uint32_t *)UArray_at(uarray, i);
-                *word = 0;
-        }
+        /* Create a new segment with all of its words set to 0 */
+        Segment *seg = allocate_segment(space, seg_length);
 
         /* Check for unmapped segment */
-        if (Seq_length(space->unmapped) == 0) {
-                /* There are no unmapped segments, so save the length of the
-                 * sequence of segments (non-zero) to register b */
-                if (!is_zero) {
-                        regs[b] = (uint32_t)Seq_length(space->in_use);
+        uint32_t ID;
+        if (space->num_unmapped == 0) {
+                /* There are no unmapped segments, so the new segment gets
+                 * the next ID at the end of the table */
+                if (space->num_segments == space->capacity) {
+                        space->segments = grow_table(space->segments,
+                                                     &space->capacity,
+                                                     sizeof(Segment *));
                 }
-
-                /* Add UArray to the end of Seq_T of in_use segments */
-                Seq_addhi(space->in_use, uarray);
+                ID = space->num_segments++;
         } else {
-                /* Reuse unmapped segments for new segment by fetching the 
-                 * index from the sequence of unmapped segments and removing it
-                 * from the unmapped sequence */
-                uint32_t unmap_index = 
-                               (uint32_t)(uintptr_t)Seq_remlo(space->unmapped);
-
-                /* Save the index of the unmapped segment to register b, which
-                 * is not all zeros */
-                regs[b] = unmap_index;
-
-                /* Add the UArray to the index of first unmapped segment */
-                Seq_put(space->in_use, unmap_index, uarray);
+                /* Reuse the most recently unmapped ID by popping it from the
+                 * stack of unmapped IDs */
+                ID = space->unmapped[--space->num_unmapped];
         }
+
+        /* Save the ID of the new segment to register b, which is not all
+         * zeros */
+        if (!is_zero) {
+                regs[b] = ID;
+        }
+
+        /* Place the segment in the table at its ID */
+        space->segments[ID] = seg;
 }
 
 /**************** unmap_segment ****************
  * 
  * Unmaps the segment $m[$r[C]] and adds the identifier $r[C] to the unmapped
- * segment sequence so that it can be mapped again.
+ * segment stack so that it can be mapped again.
  *
  * Parameters:
  *      Address_space space: an Address_space object from which we are
@@ -146,7 +215,8 @@ extern void map_segment(Address_space space, uint32_t *regs, uint32_t b,
  * Returns:
  *      None
  * Expects:
- *      $r[C] is not 0 (would be unmapping the 0 segment) if not, throw a CRE
+ *      $r[C] is not 0 (would be unmapping the 0 segment) and is a mapped
+ *      segment, if not, throw a CRE
  *
  ********************************************/
 extern void unmap_segment(Address_space space, uint32_t *regs, 
@@ -155,16 +225,192 @@ extern void unmap_segment(Address_space space, uint32_t *regs,
         /* Get the ID of the segment to be unmapped */
         uint32_t ID = regs[c_index];
 
-        /* CRE if ID is equal to 0 segment */
+        /* CRE if ID is equal to 0 segment or is not mapped */
         assert(ID != 0);
+        assert(ID < space->num_segments && space->segments[ID] != NULL);
         
         /* Free the segment at the given ID */
         free_segment(space, ID);
 
-        Seq_put(space->in_use, ID, NULL);
+        /* Push ID of the unmapped segment on the stack of unmapped IDs */
+        if (space->num_unmapped == space->unmapped_capacity) {
+                space->unmapped = grow_table(space->unmapped,
+                                             &space->unmapped_capacity,
+                                             sizeof(uint32_t));
+        }
+        space->unmapped[space->num_unmapped++] = ID;
+}
+
+/**************** share_segment ****************
+ * 
+ * Maps the segment at ID from at ID to as well, without copying it. The
+ * segment previously at ID to is released.
+ *
+ * Parameters:
+ *      Address_space space: the address space holding the segments
+ *      uint32_t from:       ID of the segment to share
+ *      uint32_t to:         ID that becomes an alias of the segment
+ * Returns:
+ *      None
+ * Expects:
+ *      The segment at from is mapped and to is less than the number of
+ *      segments, throws a CRE if not.
+ * Notes:
+ *      The words are copied later, by unshare_segment, if either alias is
+ *      written.
+ *
+ ********************************************/
+extern void share_segment(Address_space space, uint32_t from, uint32_t to)
+{
+        /* CRE if the segment being shared is not mapped */
+        assert(from < space->num_segments && to < space->num_segments);
+        Segment *seg = space->segments[from];
+        assert(seg != NULL);
 
-        /* Add ID of the unmapped segment to the sequence of unmapped IDs */
-        Seq_addlo(space->unmapped, (void *)(uintptr_t)ID);
+        /* Nothing to do if the IDs are already aliases of each other */
+        if (space->segments[to] == seg) {
+                return;
+        }
+
+        /* Release the old segment and alias the shared one in its place */
+        free_segment(space, to);
+        seg->refs++;
+        space->segments[to] = seg;
+}
+
+/**************** unshare_segment ****************
+ * 
+ * Gives the segment at ID a private copy of its words, so that it can be
+ * written without changing the other IDs it is shared with.
+ *
+ * Parameters:
+ *      Address_space space: the address space holding the segment
+ *      uint32_t ID:         ID of the shared segment about to be written
+ * Returns:
+ *      None
+ * Expects:
+ *      The segment at ID is mapped and is shared with at least one other ID.
+ *
+ ********************************************/
+extern void unshare_segment(Address_space space, uint32_t ID)
+{
+        /* Copy the shared segment in one pass */
+        Segment *shared = space->segments[ID];
+        Segment *copy = take_segment(space, shared->length);
+        memcpy(copy->words, shared->words,
+               (size_t)shared->length * sizeof(uint32_t));
+
+        /* Drop this ID's reference to the shared segment and map the copy */
+        shared->refs--;
+        space->segments[ID] = copy;
+        space->stats.cow_copies++;
+}
+
+/**************** install_segments ****************
+ *
+ * Fills an empty address space with the given table of segments and stack
+ * of unmapped IDs, as they were when a checkpoint was written.
+ *
+ * Parameters:
+ *      Address_space space:     the empty address space to fill
+ *      Segment **segments:      the segment at each ID, NULL if unmapped
+ *      uint32_t num_segments:   number of IDs in segments
+ *      const uint32_t *unmapped: the unmapped IDs, last to be reused first
+ *      uint32_t num_unmapped:   number of IDs in unmapped
+ * Returns:
+ *      None
+ * Expects:
+ *      No segment has been mapped in space. The segments' refs already
+ *      count the IDs they are at. The address space takes ownership of the
+ *      segments but not of the two arrays.
+ *
+ ********************************************/
+extern void install_segments(Address_space space, Segment **segments,
+                             uint32_t num_segments, const uint32_t *unmapped,
+                             uint32_t num_unmapped)
+{
+        assert(space->num_segments == 0 && space->num_unmapped == 0);
+
+        while (space->capacity < num_segments) {
+                space->segments = grow_table(space->segments,
+                                             &space->capacity,
+                                             sizeof(Segment *));
+        }
+        while (space->unmapped_capacity < num_unmapped) {
+                space->unmapped = grow_table(space->unmapped,
+                                             &space->unmapped_capacity,
+                                             sizeof(uint32_t));
+        }
+
+        memcpy(space->segments, segments, num_segments * sizeof(Segment *));
+        memcpy(space->unmapped, unmapped, num_unmapped * sizeof(uint32_t));
+        space->num_segments = num_segments;
+        space->num_unmapped = num_unmapped;
+}
+
+/**************** install_decoded ****************
+ *
+ * Makes the given records, mapped from a program image, the decoded copy
+ * of the 0 segment instead of decoding its words.
+ *
+ * Parameters:
+ *      Address_space space: the address space whose 0 segment they decode
+ *      Um_decoded *decoded: a private, writable mapping of the records
+ *      int length:          number of records, the length of the 0 segment
+ * Returns:
+ *      None
+ * Expects:
+ *      The records are what decode_program would produce for the 0 segment.
+ *      The address space takes ownership of the mapping and unmaps it when
+ *      the 0 segment is next replaced or the space is freed.
+ *
+ ********************************************/
+extern void install_decoded(Address_space space, Um_decoded *decoded,
+                            int length)
+{
+        assert(decoded != NULL && length > 0);
+        free_decoded(space);
+        space->decoded = decoded;
+        space->decoded_capacity = length;
+        space->decoded_mapped = true;
+}
+
+/**************** map_file_segment ****************
+ *
+ * Maps a whole segment, stored in a file as a Segment followed by its
+ * words, privately from the file, so its pages are only read when touched
+ * and writes to it never reach the file.
+ *
+ * Parameters:
+ *      int fd:          the file, open for reading
+ *      uint64_t offset: where the Segment starts, a multiple of the page
+ *                       size
+ *      uint32_t length: number of words in the segment
+ * Returns:
+ *      a pointer to the segment, with refs 1, or NULL if it could not be
+ *      mapped
+ * Expects:
+ *      The file holds the whole segment at offset.
+ *
+ ********************************************/
+extern Segment *map_file_segment(int fd, uint64_t offset, uint32_t length)
+{
+        size_t bytes = sizeof(Segment) + (size_t)length * sizeof(uint32_t);
+        if (offset % (uint64_t)sysconf(_SC_PAGESIZE) != 0) {
+                return NULL;
+        }
+        Segment *seg = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                            fd, (off_t)offset);
+        if (seg == MAP_FAILED) {
+                return NULL;
+        }
+
+        /* Freed like any other mapped segment */
+        seg->refs = 1;
+        seg->length = length;
+        seg->capacity = length;
+        seg->mmapped = 1;
+        return seg;
 }
 
 /**************** word_at ****************
@@ -180,33 +426,27 @@ extern void unmap_segment(Address_space space, uint32_t *regs,
  *      uint32_t c:          unsigned 32-bit integer representing the index
  *                           of the word inside its segment.
  * Returns:
- *      uint32_t pointer to the word
+ *      uint32_t pointer to the word, which may be written through. A segment
+ *      shared with other IDs is copied first.
  * Expects:
  *      ID is less than the number of segments in the address space.
  *      If not, throws a CRE.
  *      The segment at the given ID is not NULL, meaning unmapped. If it is, 
  *      throws a CRE.
+ *      word_index is less than the length of the segment. If not, throws a
+ *      CRE.
  *
  ********************************************/
 extern uint32_t *word_at(Address_space space, uint32_t ID, uint32_t word_index)
 {
-        /* CRE if ID is greater than the number of segments */
-        assert(ID < (uint32_t)Seq_length(space->in_use));
-
-        /* CRE if the segment at the given ID is unmapped (NULL) */
-        assert(Seq_get(space->in_use, ID) != NULL);
-
-        /* Get the UArray at the given ID */
-        UArray_T uarray = (UArray_T)Seq_get(space->in_use, ID);
-
-        /* Get the word at the specified index from UArray */
-        uint32_t *word_p = (uint32_t *)UArray_at(uarray, word_index);
-        return word_p;
+        return writable_word(space, ID, word_index);
 }
 
 /**************** free_segment ****************
  * 
- * Frees the segment at the given ID from the given address space.
+ * Releases the segment at the given ID from the given address space and
+ * leaves its slot in the table empty. Once no other ID shares the segment,
+ * its storage goes back to the pool or, if the pool is full, is freed.
  *
  * Parameters:
  *      Address_space space: an Address_space object from which we are freeing
@@ -216,17 +456,21 @@ extern uint32_t *word_at(Address_space space, uint32_t ID, uint32_t word_index)
  * Returns:
  *      None
  * Expects:
- *      The segment we are trying to free is not NULL (throws a CRE if not).
+ *      ID is less than the number of segments in the address space.
  *
  ********************************************/
 extern void free_segment(Address_space space, uint32_t ID)
 {
-        /* Get the UArray at the given ID */
-        UArray_T seg = (UArray_T)Seq_get(space->in_use, ID);
+        /* Get the segment at the given ID */
+        Segment *seg = space->segments[ID];
         
-        /* Free the UArray if it is not NULL */
+        /* Drop the reference from this ID and give up the segment if it
+         * is not NULL and no other ID shares it */
         if (seg != NULL) {
-                UArray_free(&seg);
+                if (--seg->refs == 0) {
+                        release_segment(space, seg);
+                }
+                space->segments[ID] = NULL;
         }
 }
 
@@ -245,25 +489,451 @@ extern void free_segment(Address_space space, uint32_t ID)
  ********************************************/
 extern void free_all_segments(Address_space space)
 {
-        /* Free all of the UArrays in the address space */
-        int length = Seq_length(space->in_use);
-        for (int i = 0; i < length; i++) {
-                free_segment(space, 0);
-                Seq_remlo(space->in_use);
+        /* Free all of the segments in the address space */
+        for (uint32_t ID = 0; ID < space->num_segments; ID++) {
+                free_segment(space, ID);
         }
         
-        /* Free the address space */
-        if (space->in_use != NULL) {
-                Seq_free(&(space->in_use));
+        /* Free the storage kept in the pool */
+        space->pool.limits.max_length = 0;
+        trim_pool(space);
+        for (int k = 0; k < POOL_CLASSES; k++) {
+                if (space->pool.free[k] != NULL) {
+                        FREE(space->pool.free[k]);
+                }
         }
 
-        /* Free the sequence of unmapped IDs */
+        /* Free the table of segments */
+        if (space->segments != NULL) {
+                FREE(space->segments);
+        }
+
+        /* Free the stack of unmapped IDs */
         if (space->unmapped != NULL) {
-                Seq_free(&(space->unmapped));
+                FREE(space->unmapped);
         }
 
+        /* Free the decoded copy of the 0 segment */
+        free_decoded(space);
+
         /* Free the address space */
         if (space != NULL) {
                 FREE(space);
         }
 }
+
+/**************** segment_stats ****************
+ * 
+ * Returns the instrumentation counters of the given address space.
+ *
+ * Parameters:
+ *      Address_space space: the address space to report on
+ * Returns:
+ *      a copy of the counters. The number of segment copies LOADP avoided is
+ *      loadp_shared less cow_copies.
+ * Expects:
+ *      None
+ *
+ ********************************************/
+extern Segment_stats segment_stats(Address_space space)
+{
+        return space->stats;
+}
+
+/**************** set_pool_limits ****************
+ * 
+ * Sets the caps on the storage the given address space keeps for reuse after
+ * segments are unmapped, freeing whatever the pool holds beyond them.
+ *
+ * Parameters:
+ *      Address_space space: the address space whose pool is limited
+ *      Pool_limits limits:  the new caps; a max_length of 0 turns off
+ *                           recycling
+ * Returns:
+ *      None
+ * Expects:
+ *      None
+ *
+ ********************************************/
+extern void set_pool_limits(Address_space space, Pool_limits limits)
+{
+        space->pool.limits = limits;
+        trim_pool(space);
+}
+
+/**************** set_mmap_threshold ****************
+ * 
+ * Sets the length from which segments are given their own anonymous mmap.
+ *
+ * Parameters:
+ *      Address_space space: the address space to configure
+ *      uint32_t min_length: shortest segment, in words, to mmap; segments
+ *                           already mapped keep their storage
+ * Returns:
+ *      None
+ * Expects:
+ *      None
+ *
+ ********************************************/
+extern void set_mmap_threshold(Address_space space, uint32_t min_length)
+{
+        space->mmap_min_length = min_length;
+}
+
+/**************** grow_table ****************
+ * 
+ * Doubles the number of slots allocated for a table of the address space.
+ *
+ * Parameters:
+ *      void *table:        the table to grow
+ *      uint32_t *capacity: pointer to the number of slots in the table,
+ *                          which is updated
+ *      size_t elem_size:   the size of one slot in bytes
+ * Returns:
+ *      a pointer to the grown table, which may have moved
+ * Expects:
+ *      table is not NULL and *capacity is not 0.
+ *
+ ********************************************/
+static void *grow_table(void *table, uint32_t *capacity, size_t elem_size)
+{
+        *capacity *= 2;
+        RESIZE(table, (long)*capacity * elem_size);
+        return table;
+}
+
+/**************** decode_program ****************
+ * 
+ * Decodes every word of the 0 segment into the decoded copy of the program,
+ * growing the copy if the 0 segment is longer than any decoded before.
+ *
+ * Parameters:
+ *      Address_space space: an Address_space object whose 0 segment is
+ *                           decoded.
+ * Returns:
+ *      None
+ * Expects:
+ *      The 0 segment is mapped. Must be called whenever the 0 segment is
+ *      replaced so that decoded_program matches it.
+ *
+ ********************************************/
+extern void decode_program(Address_space space)
+{
+        /* Get the 0 segment and its length */
+        Segment *program = space->segments[0];
+        assert(program != NULL);
+        int length = (int)program->length;
+
+        /* Replace the decoded copy if it cannot hold the whole segment. The
+         * old records are about to be overwritten, so they are not copied */
+        if (length > space->decoded_capacity || space->decoded_mapped) {
+                free_decoded(space);
+                space->decoded = ALLOC((long)length * sizeof(Um_decoded));
+                space->decoded_capacity = length;
+        }
+
+        /* Decode the words of the 0 segment */
+        decode_words(space->decoded, program->words, length);
+}
+
+/**************** decode_word ****************
+ * 
+ * Decodes the word at the given index of the 0 segment again, after it has
+ * been overwritten, and fuses it again with the words on either side.
+ *
+ * Parameters:
+ *      Address_space space: an Address_space object whose 0 segment was
+ *                           written to.
+ *      uint32_t word_index: index of the word in the 0 segment that changed
+ * Returns:
+ *      None
+ * Expects:
+ *      word_index is within the 0 segment, throws a CRE if not.
+ *
+ ********************************************/
+extern void decode_word(Address_space space, uint32_t word_index)
+{
+        Um_decoded *decoded = space->decoded;
+        uint32_t length = space->segments[0]->length;
+
+        decoded[word_index] =
+                       decode_instruction(*segment_word(space, 0, word_index));
+        if (word_index > 0) {
+                fuse_pair(&decoded[word_index - 1], &decoded[word_index]);
+        }
+        if (word_index + 1 < length) {
+                fuse_pair(&decoded[word_index], &decoded[word_index + 1]);
+        }
+}
+
+/**************** decoded_program ****************
+ * 
+ * Returns the decoded copy of the 0 segment.
+ *
+ * Parameters:
+ *      Address_space space: an Address_space object whose decoded program is
+ *                           returned.
+ * Returns:
+ *      pointer to the first of the decoded records, one for each word of the
+ *      0 segment.
+ * Expects:
+ *      decode_program has been called since the 0 segment was last replaced.
+ *      The pointer is invalidated by the next call to decode_program.
+ *
+ ********************************************/
+extern Um_decoded *decoded_program(Address_space space)
+{
+        return space->decoded;
+}
+
+/**************** size_class ****************
+ * 
+ * Returns the size class of a segment length: the smallest k such that the
+ * length fits in 2^k words.
+ *
+ * Parameters:
+ *      uint32_t length: number of words in a segment
+ * Returns:
+ *      the size class, from 0 to POOL_CLASSES - 1
+ * Expects:
+ *      None
+ *
+ ********************************************/
+static int size_class(uint32_t length)
+{
+        if (length <= 1) {
+                return 0;
+        }
+        return 32 - __builtin_clz(length - 1);
+}
+
+/**************** take_segment ****************
+ * 
+ * Returns storage for a segment of the given length whose words are not
+ * initialized, popping it from the pool when its size class has a free
+ * segment and allocating it otherwise. Lengths the pool recycles are given
+ * room for the whole size class so that the storage can be reused by any
+ * length of that class. Segments of at least mmap_min_length words are
+ * mmapped instead, and their words are all 0.
+ *
+ * Parameters:
+ *      Address_space space: the address space the segment will belong to
+ *      uint32_t length:     number of words in the segment
+ * Returns:
+ *      a pointer to the segment, with refs 1 and the given length
+ * Expects:
+ *      Allocation of the segment is successful.
+ *
+ ********************************************/
+static Segment *take_segment(Address_space space, uint32_t length)
+{
+        Segment_pool *pool = &space->pool;
+        Segment *seg;
+
+        /* Long segments get their own mapping, which is never pooled */
+        if (length >= space->mmap_min_length) {
+                space->stats.mmap_segments++;
+                return mmap_segment(length);
+        }
+
+        int k = size_class(length);
+        if (length <= pool->limits.max_length && k < POOL_CLASSES) {
+                if (pool->count[k] > 0) {
+                        /* Reuse a free segment of the same size class */
+                        seg = pool->free[k][--pool->count[k]];
+                        pool->words -= seg->capacity;
+                        space->stats.pool_hits++;
+                } else {
+                        /* Allocate room for the whole size class */
+                        seg = ALLOC(sizeof(Segment) +
+                                    ((long)1 << k) * sizeof(uint32_t));
+                        seg->capacity = (uint32_t)1 << k;
+                        space->stats.pool_misses++;
+                }
+        } else {
+                /* Too long to recycle, so allocate exactly the length */
+                seg = ALLOC(sizeof(Segment) + (long)length * sizeof(uint32_t));
+                seg->capacity = length;
+                space->stats.pool_misses++;
+        }
+
+        seg->mmapped = 0;
+        seg->refs = 1;
+        seg->length = length;
+        return seg;
+}
+
+/**************** release_segment ****************
+ * 
+ * Gives up the storage of a segment no ID is mapped at, keeping it in the
+ * pool for a later MAP if it fits under the pool's caps and freeing it
+ * otherwise.
+ *
+ * Parameters:
+ *      Address_space space: the address space the segment belonged to
+ *      Segment *seg:        the segment to give up
+ * Returns:
+ *      None
+ * Expects:
+ *      seg is not NULL and its refs have dropped to 0.
+ *
+ ********************************************/
+static void release_segment(Address_space space, Segment *seg)
+{
+        Segment_pool *pool = &space->pool;
+
+        /* Mapped storage goes straight back to the kernel */
+        if (seg->mmapped) {
+                munmap_segment(seg);
+                return;
+        }
+
+        /* Only storage with room for a whole size class the pool still
+         * recycles can be reused, and only if neither that class nor the
+         * whole pool is full */
+        int k = size_class(seg->capacity);
+        if (!pool_keeps_class(pool, k) || seg->capacity != (uint32_t)1 << k ||
+            pool->count[k] >= pool->limits.max_per_class ||
+            pool->words + seg->capacity > pool->limits.max_words) {
+                FREE(seg);
+                return;
+        }
+
+        /* Push the segment on the stack of its size class */
+        if (pool->count[k] == pool->slots[k]) {
+                if (pool->free[k] == NULL) {
+                        pool->slots[k] = HINT;
+                        pool->free[k] = ALLOC(HINT * sizeof(Segment *));
+                } else {
+                        pool->free[k] = grow_table(pool->free[k],
+                                                   &pool->slots[k],
+                                                   sizeof(Segment *));
+                }
+        }
+        pool->free[k][pool->count[k]++] = seg;
+        pool->words += seg->capacity;
+}
+
+/**************** pool_keeps_class ****************
+ * 
+ * Returns whether the pool's caps let it recycle segments of a size class,
+ * which is the case when some length up to max_length falls in the class.
+ *
+ * Parameters:
+ *      Segment_pool *pool: the pool
+ *      int k:              the size class
+ * Returns:
+ *      true if the pool may keep free segments of class k
+ * Expects:
+ *      pool is not NULL.
+ *
+ ********************************************/
+static bool pool_keeps_class(Segment_pool *pool, int k)
+{
+        return k < POOL_CLASSES && pool->limits.max_length > 0 &&
+               k <= size_class(pool->limits.max_length);
+}
+
+/**************** trim_pool ****************
+ * 
+ * Frees the segments in the pool that its caps no longer allow it to keep.
+ *
+ * Parameters:
+ *      Address_space space: the address space whose pool is trimmed
+ * Returns:
+ *      None
+ * Expects:
+ *      None
+ *
+ ********************************************/
+static void trim_pool(Address_space space)
+{
+        Segment_pool *pool = &space->pool;
+
+        /* Walk the classes from the largest so the total cap frees the
+         * biggest segments first */
+        for (int k = POOL_CLASSES - 1; k >= 0; k--) {
+                while (pool->count[k] > 0 &&
+                       (!pool_keeps_class(pool, k) ||
+                        pool->count[k] > pool->limits.max_per_class ||
+                        pool->words > pool->limits.max_words)) {
+                        Segment *seg = pool->free[k][--pool->count[k]];
+                        pool->words -= seg->capacity;
+                        FREE(seg);
+                }
+        }
+}
+
+/**************** mmap_segment ****************
+ * 
+ * Allocates a segment of the given length as an anonymous private mapping.
+ * The kernel maps a page in, filled with zeroes, the first time it is
+ * touched, so the words a program never uses cost neither time nor memory.
+ *
+ * Parameters:
+ *      uint32_t length: number of words in the segment
+ * Returns:
+ *      a pointer to the segment, with refs 1 and every word 0
+ * Expects:
+ *      The mapping succeeds, raises Mem_Failed if not.
+ *
+ ********************************************/
+static Segment *mmap_segment(uint32_t length)
+{
+        size_t bytes = sizeof(Segment) + (size_t)length * sizeof(uint32_t);
+        Segment *seg = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (seg == MAP_FAILED) {
+                RAISE(Mem_Failed);
+        }
+
+        seg->refs = 1;
+        seg->length = length;
+        seg->capacity = length;
+        seg->mmapped = 1;
+        return seg;
+}
+
+/**************** munmap_segment ****************
+ * 
+ * Returns the pages of a mapped segment to the kernel.
+ *
+ * Parameters:
+ *      Segment *seg: a segment allocated by mmap_segment
+ * Returns:
+ *      None
+ * Expects:
+ *      seg is not NULL and no ID is mapped at it.
+ *
+ ********************************************/
+static void munmap_segment(Segment *seg)
+{
+        size_t bytes = sizeof(Segment) +
+                       (size_t)seg->capacity * sizeof(uint32_t);
+        munmap(seg, bytes);
+}
+
+/**************** free_decoded ****************
+ * 
+ * Frees or unmaps the decoded copy of the 0 segment, if there is one.
+ *
+ * Parameters:
+ *      Address_space space: the address space whose decoded copy is freed
+ * Returns:
+ *      None
+ * Expects:
+ *      None
+ *
+ ********************************************/
+static void free_decoded(Address_space space)
+{
+        if (space->decoded_mapped) {
+                munmap(space->decoded, (size_t)space->decoded_capacity *
+                                       sizeof(Um_decoded));
+        } else if (space->decoded != NULL) {
+                FREE(space->decoded);
+        }
+        space->decoded = NULL;
+        space->decoded_capacity = 0;
+        space->decoded_mapped = false;
+}
@@ -9,7 +9,9 @@
  *     Summary: Function declarations for the Address_space ADT. The functions
  *              in this file are used to create a new instance of an address
  *              space, map and unmap segments, get a pointer to a word in the
- *              address space, and free associated memory.
+ *              address space, and free associated memory. The address space
+ *              also keeps a pre-decoded copy of the 0 segment for the
+ *              execution engines.
  * 
  **************************************************************/
 
@@ -18,13 +20,40 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "seq.h"
+#include "decode.h"
 
 /*****************************************************************
  *                  Address_space Declaration
  *****************************************************************/
 typedef struct Address_space *Address_space;
 
+/********** Segment_stats ********
+ * 
+ * Struct to hold the instrumentation counters kept by an address space.
+ *
+ *******************/
+typedef struct Segment_stats {
+        uint64_t loadp_shared; /* LOADPs that made the 0 segment an alias of
+                                * the source segment instead of copying it */
+        uint64_t cow_copies;   /* shared segments that had to be copied
+                                * because one of their aliases was written */
+        uint64_t pool_hits;    /* segments allocated from recycled storage */
+        uint64_t pool_misses;  /* segments allocated from the heap */
+        uint64_t mmap_segments; /* segments allocated with their own mmap */
+} Segment_stats;
+
+/********** Pool_limits ********
+ * 
+ * Struct to hold the caps on the storage an address space keeps for reuse
+ * after segments are unmapped. A max_length of 0 turns recycling off.
+ *
+ *******************/
+typedef struct Pool_limits {
+        uint32_t max_length;    /* longest segment, in words, recycled */
+        uint32_t max_per_class; /* most free segments kept per size class */
+        uint64_t max_words;     /* most words kept across all size classes */
+} Pool_limits;
+
 /*****************************************************************
  *                  Function Declarations
  *****************************************************************/
@@ -37,5 +66,15 @@ extern uint32_t *word_at(Address_space space, uint32_t ID,
                                                           uint32_t word_index);
 extern void free_segment(Address_space space, uint32_t ID);
 extern void free_all_segments(Address_space space);
+extern Segment_stats segment_stats(Address_space space);
+extern void set_pool_limits(Address_space space, Pool_limits limits);
+extern void set_mmap_threshold(Address_space space, uint32_t min_length);
+
+/*****************************************************************
+ *                  Decoded Program Declarations
+ *****************************************************************/
+extern void decode_program(Address_space space);
+extern void decode_word(Address_space space, uint32_t word_index);
+extern Um_decoded *decoded_program(Address_space space);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,200 @@
+/**************************************************************
+ *
+ *                     segment_private.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Representation of the Address_space ADT, shared by the
+ *              segment module and the modules that operate on segments
+ *              directly (operations and the execution engines). Clients of
+ *              the address space should use segment.h instead.
+ *
+ **************************************************************/
+
+#ifndef SEGMENT_PRIVATE_H
+#define SEGMENT_PRIVATE_H
+
+#include <stdint.h>
+#include "assert.h"
+#include "segment.h"
+
+/********** Segment ********
+ *
+ * A segment is a single allocation holding its length followed by its
+ * words, so that reaching a word takes one load from the segment table.
+ * A segment may be shared by several IDs after a LOADP, in which case refs
+ * counts the IDs and the words are copied before any of them is written.
+ * Segments of at least mmap_min_length words are anonymous mmaps, whose
+ * pages the kernel supplies zeroed only once they are touched.
+ *
+ *******************/
+typedef struct Segment {
+        uint32_t refs;     /* number of IDs the segment is mapped at */
+        uint32_t length;   /* number of words in the segment */
+        uint32_t capacity; /* number of words the storage has room for */
+        uint32_t mmapped;  /* 1 if the storage is an anonymous mmap */
+        uint32_t words[];  /* the words of the segment */
+} Segment;
+
+/* Number of size classes in the segment pool: class k recycles segments
+ * whose length rounds up to 2^k words */
+#define POOL_CLASSES 32
+
+/********** Segment_pool ********
+ *
+ * Struct to hold the storage of unmapped segments kept for reuse by later
+ * MAPs. Each size class is a stack of free segments, all with room for
+ * 2^k words.
+ *
+ *******************/
+typedef struct Segment_pool {
+        Segment **free[POOL_CLASSES]; /* stack of free segments per class */
+        uint32_t count[POOL_CLASSES]; /* segments on each stack */
+        uint32_t slots[POOL_CLASSES]; /* slots allocated for each stack */
+        uint64_t words;               /* words held across all classes */
+        Pool_limits limits;           /* caps on what the pool keeps */
+} Segment_pool;
+
+/********** Address_space ********
+ *
+ * Struct to hold all the information needed to manage the segments in the
+ * address space: a flat table of segments indexed by ID, in which unmapped
+ * IDs hold NULL, a stack of the unmapped IDs available for reuse, the pool
+ * of storage from unmapped segments, the decoded copy of the 0 segment, and
+ * the instrumentation counters.
+ *
+ *******************/
+struct Address_space {
+        Segment **segments;     /* table of segments indexed by ID */
+        uint32_t num_segments;  /* number of IDs handed out so far */
+        uint32_t capacity;      /* number of slots allocated in segments */
+        uint32_t *unmapped;     /* stack of unmapped IDs, last is reused */
+        uint32_t num_unmapped;  /* number of IDs on the unmapped stack */
+        uint32_t unmapped_capacity; /* number of slots allocated in unmapped */
+        Um_decoded *decoded;    /* the 0 segment decoded into instructions */
+        int decoded_capacity;   /* number of records allocated for decoded */
+        bool decoded_mapped;    /* decoded is mapped from a program image */
+        Segment_pool pool;      /* storage recycled from unmapped segments */
+        uint32_t mmap_min_length; /* shortest segment given its own mmap */
+        Segment_stats stats;    /* instrumentation counters */
+};
+
+/*****************************************************************
+ *                  Private Function Declarations
+ *****************************************************************/
+extern Segment *allocate_segment(Address_space space, uint32_t length);
+extern void share_segment(Address_space space, uint32_t from, uint32_t to);
+extern void unshare_segment(Address_space space, uint32_t ID);
+extern void install_segments(Address_space space, Segment **segments,
+                             uint32_t num_segments, const uint32_t *unmapped,
+                             uint32_t num_unmapped);
+extern void install_decoded(Address_space space, Um_decoded *decoded,
+                            int length);
+extern Segment *map_file_segment(int fd, uint64_t offset, uint32_t length);
+
+/**************** segment_word ****************
+ *
+ * Returns a pointer to the word at the given index of the segment at the
+ * given ID. This is word_at, inlined for the execution engines.
+ *
+ * Parameters:
+ *      Address_space space: the address space holding the segment
+ *      uint32_t ID:         the ID of the segment
+ *      uint32_t index:      the index of the word inside its segment
+ * Returns:
+ *      uint32_t pointer to the word
+ * Expects:
+ *      The segment at ID is mapped and index is within it, throws a CRE if
+ *      not.
+ *
+ ********************************************/
+static inline uint32_t *segment_word(Address_space space, uint32_t ID,
+                                     uint32_t index)
+{
+        assert(ID < space->num_segments);
+        Segment *seg = space->segments[ID];
+        assert(seg != NULL);
+        assert(index < seg->length);
+        return &seg->words[index];
+}
+
+/**************** writable_word ****************
+ *
+ * Returns a pointer to the word at the given index of the segment at the
+ * given ID that may be written through. If the segment is shared with other
+ * IDs, the segment at ID is first replaced by a private copy.
+ *
+ * Parameters:
+ *      Address_space space: the address space holding the segment
+ *      uint32_t ID:         the ID of the segment
+ *      uint32_t index:      the index of the word inside its segment
+ * Returns:
+ *      uint32_t pointer to the word
+ * Expects:
+ *      The segment at ID is mapped and index is within it, throws a CRE if
+ *      not.
+ *
+ ********************************************/
+static inline uint32_t *writable_word(Address_space space, uint32_t ID,
+                                      uint32_t index)
+{
+        uint32_t *word = segment_word(space, ID, index);
+        if (space->segments[ID]->refs > 1) {
+                unshare_segment(space, ID);
+                word = &space->segments[ID]->words[index];
+        }
+        return word;
+}
+
+/**************** unchecked_word ****************
+ *
+ * Returns a pointer to the word at the given index of the segment at the
+ * given ID, like segment_word but without its checks, for engines that
+ * have made them already or that trust the program.
+ *
+ * Parameters:
+ *      Address_space space: the address space holding the segment
+ *      uint32_t ID:         the ID of the segment
+ *      uint32_t index:      the index of the word inside its segment
+ * Returns:
+ *      uint32_t pointer to the word
+ * Expects:
+ *      The segment at ID is mapped and index is within it; the behavior is
+ *      undefined if not.
+ *
+ ********************************************/
+static inline uint32_t *unchecked_word(Address_space space, uint32_t ID,
+                                       uint32_t index)
+{
+        return &space->segments[ID]->words[index];
+}
+
+/**************** unchecked_writable_word ****************
+ *
+ * Returns a pointer to the word at the given index of the segment at the
+ * given ID that may be written through, like writable_word but without
+ * the checks of segment_word.
+ *
+ * Parameters:
+ *      Address_space space: the address space holding the segment
+ *      uint32_t ID:         the ID of the segment
+ *      uint32_t index:      the index of the word inside its segment
+ * Returns:
+ *      uint32_t pointer to the word
+ * Expects:
+ *      The segment at ID is mapped and index is within it; the behavior is
+ *      undefined if not.
+ *
+ ********************************************/
+static inline uint32_t *unchecked_writable_word(Address_space space,
+                                                uint32_t ID, uint32_t index)
+{
+        if (space->segments[ID]->refs > 1) {
+                unshare_segment(space, ID);
+        }
+        return &space->segments[ID]->words[index];
+}
+
+#endif
@@ -0,0 +1,270 @@
+/**************************************************************
+ *
+ *                     stats.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of the functions that create, print and free
+ *              the execution counters. The counters are printed on stderr
+ *              when the machine is freed, either as one JSON object
+ *              (--stats) or as one line about fused pairs
+ *              (--fusion-report).
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "stats.h"
+#include "mem.h"
+#include "assert.h"
+
+/* Number of opcode bigrams printed, most frequent first */
+#define TOP_BIGRAMS 32
+
+/* Number of valid opcodes, CMOV through LV */
+#define NUM_VALID_OPCODES (LV + 1)
+
+/* Names of the opcodes and of the kinds of fused pair */
+static const char *const opcode_names[NUM_VALID_OPCODES] = {
+        "CMOV", "SLOAD", "SSTORE", "ADD", "MUL", "DIV", "NAND",
+        "HALT", "MAP", "UNMAP", "OUT", "IN", "LOADP", "LV"
+};
+static const char *const fusion_names[NUM_FUSIONS] = {
+        "sload_add", "nand_nand", "lv_add", "lv_loadp"
+};
+
+/********** Bigram ********
+ *
+ * One opcode bigram and how often it was executed, for sorting.
+ *
+ *******************/
+typedef struct Bigram {
+        int first, second;
+        uint64_t count;
+} Bigram;
+
+/* Declarations for the helpers that print each report */
+static void print_json(FILE *fp, const Um_stats *stats,
+                       Segment_stats segments, uint64_t input_bytes,
+                       uint64_t executed, double seconds);
+static void print_fusion(FILE *fp, const Um_stats *stats, uint64_t executed);
+static int compare_bigrams(const void *a, const void *b);
+
+/**************** new_stats ****************
+ *
+ * Creates a new set of counters, all 0, and starts the clock used to
+ * compute the execution rate.
+ *
+ * Parameters:
+ *      bool print_json:   whether print_stats prints the JSON report
+ *      bool print_fusion: whether print_stats prints the fusion line
+ * Returns:
+ *      pointer to the new Um_stats
+ * Expects:
+ *      The client frees the counters with free_stats.
+ *
+ ********************************************/
+extern Um_stats *new_stats(bool print_json, bool print_fusion)
+{
+        Um_stats *stats;
+        NEW0(stats);
+        stats->print_json = print_json;
+        stats->print_fusion = print_fusion;
+        clock_gettime(CLOCK_MONOTONIC, &stats->start);
+        return stats;
+}
+
+/**************** print_stats ****************
+ *
+ * Prints the reports that were asked for when the counters were created.
+ *
+ * Parameters:
+ *      FILE *fp:               the stream to print to
+ *      const Um_stats *stats:  the counters kept by the engine
+ *      Segment_stats segments: the counters kept by the address space
+ *      uint64_t input_bytes:   characters the program read with IN
+ * Returns:
+ *      None
+ * Expects:
+ *      fp and stats are not NULL.
+ * Notes:
+ *      The execution rate is measured up to the call to print_stats, so it
+ *      should be called as soon as the program stops.
+ *
+ ********************************************/
+extern void print_stats(FILE *fp, const Um_stats *stats,
+                        Segment_stats segments, uint64_t input_bytes)
+{
+        assert(fp != NULL && stats != NULL);
+
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - stats->start.tv_sec) +
+                         (end.tv_nsec - stats->start.tv_nsec) / 1e9;
+
+        uint64_t executed = 0;
+        for (int op = 0; op < NUM_OPCODES; op++) {
+                executed += stats->opcodes[op];
+        }
+
+        if (stats->print_fusion) {
+                print_fusion(fp, stats, executed);
+        }
+        if (stats->print_json) {
+                print_json(fp, stats, segments, input_bytes, executed,
+                           seconds);
+        }
+}
+
+/**************** free_stats ****************
+ *
+ * Frees the given counters and sets the client's pointer to NULL.
+ *
+ * Parameters:
+ *      Um_stats **stats: pointer to the counters to free
+ * Returns:
+ *      None
+ * Expects:
+ *      stats and *stats are not NULL.
+ *
+ ********************************************/
+extern void free_stats(Um_stats **stats)
+{
+        assert(stats != NULL && *stats != NULL);
+        FREE(*stats);
+}
+
+/**************** print_json ****************
+ *
+ * Prints all the counters as one JSON object: the instructions executed
+ * and the rate in millions per second, the count of each opcode, the
+ * TOP_BIGRAMS most frequent opcode bigrams, the LOADPs split into jumps and
+ * loads of another segment, the MAPs and UNMAPs, the loads and stores of
+ * the same segment as the last one with their rate, the address space
+ * counters, the fused pairs, and the characters read.
+ *
+ ********************************************/
+static void print_json(FILE *fp, const Um_stats *stats,
+                       Segment_stats segments, uint64_t input_bytes,
+                       uint64_t executed, double seconds)
+{
+        double mips = seconds > 0 ? executed / seconds / 1e6 : 0.0;
+
+        fprintf(fp, "{\"instructions\": %llu, \"seconds\": %.6f, "
+                    "\"mips\": %.2f,\n", (unsigned long long)executed,
+                seconds, mips);
+
+        fprintf(fp, " \"opcodes\": {");
+        for (int op = 0; op < NUM_VALID_OPCODES; op++) {
+                fprintf(fp, "%s\"%s\": %llu", op == 0 ? "" : ", ",
+                        opcode_names[op],
+                        (unsigned long long)stats->opcodes[op]);
+        }
+        fprintf(fp, "},\n");
+
+        /* Sort the bigrams that occurred, most frequent first */
+        Bigram bigrams[NUM_VALID_OPCODES * NUM_VALID_OPCODES];
+        int num_bigrams = 0;
+        for (int first = 0; first < NUM_VALID_OPCODES; first++) {
+                for (int second = 0; second < NUM_VALID_OPCODES; second++) {
+                        uint64_t count = stats->bigrams[first][second];
+                        if (count != 0) {
+                                bigrams[num_bigrams++] =
+                                        (Bigram){ first, second, count };
+                        }
+                }
+        }
+        qsort(bigrams, num_bigrams, sizeof(Bigram), compare_bigrams);
+
+        fprintf(fp, " \"bigrams\": [");
+        for (int i = 0; i < num_bigrams && i < TOP_BIGRAMS; i++) {
+                fprintf(fp, "%s{\"first\": \"%s\", \"second\": \"%s\", "
+                            "\"count\": %llu}", i == 0 ? "" : ", ",
+                        opcode_names[bigrams[i].first],
+                        opcode_names[bigrams[i].second],
+                        (unsigned long long)bigrams[i].count);
+        }
+        fprintf(fp, "],\n");
+
+        fprintf(fp, " \"loadp\": {\"jumps\": %llu, \"loads\": %llu}, "
+                    "\"map\": %llu, \"unmap\": %llu,\n",
+                (unsigned long long)stats->loadp_jumps,
+                (unsigned long long)stats->loadp_loads,
+                (unsigned long long)stats->opcodes[MAP],
+                (unsigned long long)stats->opcodes[UNMAP]);
+
+        uint64_t accesses = stats->same_segment + stats->other_segment;
+        fprintf(fp, " \"segment_reuse\": {\"same\": %llu, \"other\": %llu, "
+                    "\"rate\": %.4f},\n",
+                (unsigned long long)stats->same_segment,
+                (unsigned long long)stats->other_segment,
+                accesses == 0 ? 0.0 :
+                        (double)stats->same_segment / accesses);
+
+        fprintf(fp, " \"segments\": {\"loadp_shared\": %llu, "
+                    "\"cow_copies\": %llu, \"pool_hits\": %llu, "
+                    "\"pool_misses\": %llu, \"mmap_segments\": %llu},\n",
+                (unsigned long long)segments.loadp_shared,
+                (unsigned long long)segments.cow_copies,
+                (unsigned long long)segments.pool_hits,
+                (unsigned long long)segments.pool_misses,
+                (unsigned long long)segments.mmap_segments);
+
+        uint64_t pairs = 0;
+        fprintf(fp, " \"fusion\": {");
+        for (int i = 0; i < NUM_FUSIONS; i++) {
+                pairs += stats->fused[i];
+                fprintf(fp, "\"%s\": %llu, ", fusion_names[i],
+                        (unsigned long long)stats->fused[i]);
+        }
+        fprintf(fp, "\"rate\": %.4f},\n",
+                executed == 0 ? 0.0 : (double)(2 * pairs) / executed);
+
+        fprintf(fp, " \"input_bytes\": %llu}\n",
+                (unsigned long long)input_bytes);
+}
+
+/**************** print_fusion ****************
+ *
+ * Prints one line saying how many of the instructions executed ran as part
+ * of a fused pair, and how often each kind of pair ran.
+ *
+ ********************************************/
+static void print_fusion(FILE *fp, const Um_stats *stats, uint64_t executed)
+{
+        uint64_t pairs = 0;
+        for (int i = 0; i < NUM_FUSIONS; i++) {
+                pairs += stats->fused[i];
+        }
+        double rate = executed == 0 ? 0.0 : 100.0 * (2 * pairs) / executed;
+
+        fprintf(fp, "fusion: %llu of %llu instructions (%.1f%%) ran fused;",
+                (unsigned long long)(2 * pairs),
+                (unsigned long long)executed, rate);
+        for (int i = 0; i < NUM_FUSIONS; i++) {
+                fprintf(fp, " %s %llu", fusion_names[i],
+                        (unsigned long long)stats->fused[i]);
+        }
+        fprintf(fp, "\n");
+}
+
+/**************** compare_bigrams ****************
+ *
+ * qsort comparison that orders bigrams by decreasing count, then by opcode.
+ *
+ ********************************************/
+static int compare_bigrams(const void *a, const void *b)
+{
+        const Bigram *x = a;
+        const Bigram *y = b;
+        if (x->count != y->count) {
+                return x->count < y->count ? 1 : -1;
+        }
+        if (x->first != y->first) {
+                return x->first - y->first;
+        }
+        return x->second - y->second;
+}
@@ -0,0 +1,60 @@
+/**************************************************************
+ *
+ *                     stats.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Declaration of the Um_stats struct, which holds the
+ *              execution counters kept by the counting engine when um is run
+ *              with --stats or --fusion-report, and of the functions that
+ *              create, print and free one.
+ * 
+ **************************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "segment.h"
+#include "decode.h"
+
+/* Number of values of the 4-bit opcode field */
+#define NUM_OPCODES 16
+
+/********** Um_stats ********
+ * 
+ * Struct to hold the counts of what a program executed. Each instruction
+ * of a fused pair is counted as itself, so the counts are the same whether
+ * or not the pair ran fused.
+ *
+ *******************/
+typedef struct Um_stats {
+        uint64_t opcodes[NUM_OPCODES];               /* per opcode */
+        uint64_t bigrams[NUM_OPCODES + 1][NUM_OPCODES]; /* per pair in a
+                                                 * row; the first instruction
+                                                 * follows row NUM_OPCODES */
+        uint64_t loadp_jumps;       /* LOADPs with register b equal to 0 */
+        uint64_t loadp_loads;       /* LOADPs of another segment */
+        uint64_t same_segment;      /* SLOADs and SSTOREs of the segment
+                                     * the last one accessed */
+        uint64_t other_segment;     /* SLOADs and SSTOREs of another one */
+        uint64_t fused[NUM_FUSIONS]; /* times each pair ran fused */
+        struct timespec start;      /* when execution started */
+        bool print_json;            /* print everything as JSON */
+        bool print_fusion;          /* print one line about fusion */
+} Um_stats;
+
+/*****************************************************************
+ *                  Function Declarations
+ *****************************************************************/
+extern Um_stats *new_stats(bool print_json, bool print_fusion);
+extern void print_stats(FILE *fp, const Um_stats *stats,
+                        Segment_stats segments, uint64_t input_bytes);
+extern void free_stats(Um_stats **stats);
+
+#endif
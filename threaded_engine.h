@@ -0,0 +1,509 @@
+/**************************************************************
+ *
+ *                     threaded_engine.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Body of the direct-threaded execution engine, included by
+ *              threaded_execute.c once for each variant of the engine.
+ *              Before including it, define ENGINE_NAME as the name of the
+ *              function to define, COUNTING as 1 to count every instruction
+ *              into the machine's Um_stats or 0 to count nothing, and
+ *              PROFILING as 1 to publish the program counter for the
+ *              sampling profiler or 0 not to, and CHECKPOINTING as 1 to
+ *              write a checkpoint when one is asked for or 0 not to, so that
+ *              the plain engine carries no instrumentation at all. CHECKED
+ *              set to 1 checks every segment access, division and output
+ *              and stops the machine with a reason when one fails; set to 0
+ *              it trusts the program and makes none of those checks.
+ *              SCHEDULED set to 1 runs the machine for a turn of
+ *              vm->quantum instructions, or until it would wait for input
+ *              or for its output to be written, and leaves it to be
+ *              resumed later; set to 0 the machine runs until it stops.
+ *              EXACT set to 1, with SCHEDULED, ends a turn after exactly
+ *              vm->quantum instructions, checking before every instruction
+ *              and running fused pairs as their two instructions; set to 0
+ *              a turn only ends at a jump.
+ *
+ **************************************************************/
+
+#if COUNTING
+/* Counts an executed instruction with the given opcode */
+#define COUNT(op)                                                       \
+        do {                                                            \
+                stats->opcodes[(op)]++;                                 \
+                stats->bigrams[last_op][(op)]++;                        \
+                last_op = (op);                                         \
+        } while (0)
+#define COUNT_LOADP(jump)                                               \
+        do {                                                            \
+                if (jump) {                                             \
+                        stats->loadp_jumps++;                           \
+                } else {                                                \
+                        stats->loadp_loads++;                           \
+                }                                                       \
+        } while (0)
+#define COUNT_FUSED(pair) (stats->fused[(pair)]++)
+
+/* Counts a load or store of the segment at ID as one of the same segment
+ * as the last, or of another. FORGET_SEGMENT starts over after the
+ * segment at ID is unmapped or replaced */
+#define COUNT_SEGMENT(ID)                                               \
+        do {                                                            \
+                if ((ID) == last_segment) {                             \
+                        stats->same_segment++;                          \
+                } else {                                                \
+                        stats->other_segment++;                         \
+                        last_segment = (ID);                            \
+                }                                                       \
+        } while (0)
+#define FORGET_SEGMENT(ID)                                              \
+        do {                                                            \
+                if ((ID) == last_segment) {                             \
+                        last_segment = NO_SEGMENT;                      \
+                }                                                       \
+        } while (0)
+#else
+#define COUNT(op) ((void)0)
+#define COUNT_LOADP(jump) ((void)0)
+#define COUNT_FUSED(pair) ((void)0)
+#define COUNT_SEGMENT(ID) ((void)0)
+#define FORGET_SEGMENT(ID) ((void)0)
+#endif
+
+#if PROFILING
+/* Publishes the program counter, and the ID of the segment a LOADP copied
+ * into the 0 segment */
+#define PUBLISH_PC() (profile_pc = (uint32_t)prog_counter)
+#define PUBLISH_PROGRAM(ID) (profile_program = (ID))
+#else
+#define PUBLISH_PC() ((void)0)
+#define PUBLISH_PROGRAM(ID) ((void)0)
+#endif
+
+#if CHECKPOINTING
+/* Writes a checkpoint before the next instruction once the countdown of
+ * instructions runs out or SIGUSR1 asked for one. The countdown only runs
+ * out once */
+#define CHECKPOINT()                                                    \
+        do {                                                            \
+                if (--countdown == 0 || checkpoint_requested) {         \
+                        for (int i = 0; i < NUM_REGISTERS; i++) {       \
+                                vm->registers[i] = r[i];                \
+                        }                                               \
+                        vm->prog_counter = (uint32_t)prog_counter;      \
+                        write_checkpoint(vm);                           \
+                }                                                       \
+        } while (0)
+#define TICK_FUSED() (countdown -= countdown > 1)
+#else
+#define CHECKPOINT() ((void)0)
+#define TICK_FUSED() ((void)0)
+#endif
+
+#if SCHEDULED
+/* Leaves the engine in the given state, to be resumed at the program
+ * counter */
+#define YIELD(new_state)                                                \
+        do {                                                            \
+                vm->state = (new_state);                                \
+                goto yield;                                             \
+        } while (0)
+
+/* Instructions are counted a run at a time, from the target of one jump
+ * to the next jump, so that nothing but jumps pay for the count. END_RUN
+ * counts the run up to and including the jump at the program counter, and
+ * START_RUN starts one at the jump's target, ending the turn there if the
+ * quantum is used up */
+#define END_RUN() (executed += prog_counter + 1 - run_start)
+#define START_RUN()                                                     \
+        do {                                                            \
+                run_start = prog_counter;                               \
+                if (executed >= turn_end) {                             \
+                        YIELD(MACHINE_READY);                           \
+                }                                                       \
+        } while (0)
+
+/* Ends the turn at an input or output instruction that would have to
+ * wait */
+#define WAIT_FOR_INPUT()                                                \
+        do {                                                            \
+                if (!input_ready(input_buf)) {                          \
+                        YIELD(MACHINE_BLOCKED);                         \
+                }                                                       \
+        } while (0)
+#define WAIT_FOR_OUTPUT()                                               \
+        do {                                                            \
+                if (!output_ready(out)) {                               \
+                        YIELD(MACHINE_BLOCKED_OUTPUT);                  \
+                }                                                       \
+        } while (0)
+#else
+#define END_RUN() ((void)0)
+#define START_RUN() ((void)0)
+#define WAIT_FOR_INPUT() ((void)0)
+#define WAIT_FOR_OUTPUT() ((void)0)
+#endif
+
+#if SCHEDULED && EXACT
+/* Ends the turn before the next instruction once the quantum is used up.
+ * Fused pairs dispatch to the handler of their first instruction, so that
+ * the turn can end between the two */
+#define END_TURN()                                                      \
+        do {                                                            \
+                if (executed + (prog_counter - run_start) >= turn_end) { \
+                        YIELD(MACHINE_READY);                           \
+                }                                                       \
+        } while (0)
+#define HANDLER(in) handlers[(in)->op & OPCODE_MASK]
+#else
+#define END_TURN() ((void)0)
+#define HANDLER(in) handlers[(in)->op]
+#endif
+
+/* Stops the machine at the current instruction, for the caller to report
+ * the reason. Invalid instructions stop every variant this way */
+#define FAIL(reason)                                                    \
+        do {                                                            \
+                vm->failure_code = (reason);                            \
+                vm->failure = failure_message(reason);                  \
+                goto failed;                                            \
+        } while (0)
+
+#if CHECKED
+/* Stops the machine if the condition does not hold */
+#define CHECK(condition, reason)                                        \
+        do {                                                            \
+                if (!(condition)) {                                     \
+                        FAIL(reason);                                   \
+                }                                                       \
+        } while (0)
+#else
+#define CHECK(condition, reason) ((void)0)
+#endif
+
+/* Checks that a segment is mapped at ID and that index is inside it */
+#define CHECK_WORD(ID, index)                                           \
+        do {                                                            \
+                CHECK((ID) < space->num_segments &&                     \
+                      space->segments[(ID)] != NULL,                    \
+                      FAILURE_UNMAPPED_SEGMENT);                        \
+                CHECK((index) < space->segments[(ID)]->length,          \
+                      FAILURE_BAD_INDEX);                               \
+        } while (0)
+
+/*************** ENGINE_NAME ***************
+ *
+ * Executes the instructions which are contained in the 0 segment of the
+ * given address space using direct-threaded dispatch.
+ *
+ * Parameters:
+ *      Machine vm:      the machine whose address space holds the
+ *                       instructions in the 0 segment and whose registers
+ *                       they operate on.
+ *      size_t num_inst: number of instructions in the 0 segment
+ * Returns:
+ *      None.
+ * Expects:
+ *      The same as execute_instructions. The counting variant also expects
+ *      vm->stats to be non-NULL, and the checkpointing variants expect
+ *      start_checkpoints to have been called. The unchecked variant expects
+ *      a program that never fails, and the scheduled variant a quantum
+ *      greater than 0.
+ * Notes:
+ *      The decoded copy of the 0 segment is cached in a local and is only
+ *      fetched again after a LOADP replaces the 0 segment, since stores into
+ *      the 0 segment update the decoded records in place. The registers are
+ *      copied back to the machine when the program counter runs off the end
+ *      of the 0 segment. The scheduled variant only checks its quantum at
+ *      jumps, so a turn can run past it by as many instructions as there
+ *      are between two jumps; the budgeted variant checks it before every
+ *      instruction instead. Both leave the program counter in the machine
+ *      when they return.
+ *
+ ********************************************/
+extern void ENGINE_NAME(Machine vm, size_t num_inst)
+{
+        /* Table of handlers indexed by decoded opcode. Opcodes 14 and 15
+         * are not valid instructions, and above 15 only the fused opcodes
+         * have handlers */
+        static void *const handlers[NUM_DECODED_OPS] = {
+                &&do_cmov, &&do_sload, &&do_sstore, &&do_add, &&do_mul,
+                &&do_div, &&do_nand, &&do_halt, &&do_map, &&do_unmap,
+                &&do_out, &&do_in, &&do_loadp, &&do_lv, &&do_fail, &&do_fail,
+
+                /* 0x10 - 0x1F */
+                &&do_fail, &&do_sload_add, &&do_fail, &&do_fail, &&do_fail,
+                &&do_fail, &&do_nand_nand, &&do_fail, &&do_fail, &&do_fail,
+                &&do_fail, &&do_fail, &&do_fail, &&do_lv_add, &&do_fail,
+                &&do_fail,
+
+                /* 0x20 - 0x2F */
+                &&do_fail, &&do_fail, &&do_fail, &&do_fail, &&do_fail,
+                &&do_fail, &&do_fail, &&do_fail, &&do_fail, &&do_fail,
+                &&do_fail, &&do_fail, &&do_fail, &&do_lv_loadp, &&do_fail,
+                &&do_fail
+        };
+
+        /* Address space and input and output buffers of the machine */
+        Address_space space = vm->space;
+        Input_buffer input_buf = vm->in;
+        Output_buffer out = vm->out;
+
+        /* Local copy of the registers */
+        uint32_t r[NUM_REGISTERS];
+        for (int i = 0; i < NUM_REGISTERS; i++) {
+                r[i] = vm->registers[i];
+        }
+
+        /* Program counter, current instruction, and decoded 0 segment */
+        size_t prog_counter = vm->prog_counter;
+        Um_decoded *in;
+        Um_decoded *program = decoded_program(space);
+
+#if COUNTING
+        /* Counters, and the opcode of the last instruction executed */
+        Um_stats *stats = vm->stats;
+        int last_op = NUM_OPCODES;
+
+        /* ID of the segment the last load or store accessed, or
+         * NO_SEGMENT, which no 32-bit ID equals */
+        const uint64_t NO_SEGMENT = UINT64_MAX;
+        uint64_t last_segment = NO_SEGMENT;
+#endif
+
+#if CHECKPOINTING
+        /* Instructions left to run before the checkpoint asked for with
+         * --checkpoint-at, or 0 if none was */
+        uint64_t countdown = checkpoint_at == 0 ? 0 : checkpoint_at + 1;
+#endif
+
+#if SCHEDULED
+        /* Instructions run before the current run, the count at which the
+         * turn ends, and where the current run started */
+        uint64_t executed = vm->instructions;
+        uint64_t turn_end = executed + vm->quantum;
+        size_t run_start = prog_counter;
+        vm->state = MACHINE_STOPPED;
+#endif
+
+/* Fetches the instruction at the program counter and jumps to its handler,
+ * leaving the loop if the program counter is past the end of the 0 segment */
+#define DISPATCH()                                                      \
+        do {                                                            \
+                END_TURN();                                             \
+                if (prog_counter >= num_inst) {                         \
+                        goto done;                                      \
+                }                                                       \
+                CHECKPOINT();                                           \
+                in = &program[prog_counter];                            \
+                COUNT(in->op & OPCODE_MASK);                            \
+                PUBLISH_PC();                                           \
+                goto *HANDLER(in);                                      \
+        } while (0)
+
+/* Advances to the next instruction and dispatches it */
+#define NEXT()                                                          \
+        do {                                                            \
+                prog_counter++;                                         \
+                DISPATCH();                                             \
+        } while (0)
+
+        DISPATCH();
+
+do_cmov:
+        if (r[in->c] != 0) {
+                r[in->a] = r[in->b];
+        }
+        NEXT();
+
+do_sload:
+        CHECK_WORD(r[in->b], r[in->c]);
+        COUNT_SEGMENT(r[in->b]);
+        r[in->a] = *unchecked_word(space, r[in->b], r[in->c]);
+        NEXT();
+
+do_sstore:
+        {
+                /* The store may overwrite the record in points to, so the
+                 * target is read out before the store */
+                uint32_t ID = r[in->a];
+                uint32_t index = r[in->b];
+                CHECK_WORD(ID, index);
+                COUNT_SEGMENT(ID);
+                *unchecked_writable_word(space, ID, index) = r[in->c];
+
+                /* Keep the decoded copy of the 0 segment up to date */
+                if (ID == 0) {
+                        decode_word(space, index);
+                }
+        }
+        NEXT();
+
+do_add:
+        r[in->a] = r[in->b] + r[in->c];
+        NEXT();
+
+do_mul:
+        r[in->a] = r[in->b] * r[in->c];
+        NEXT();
+
+do_div:
+        CHECK(r[in->c] != 0, FAILURE_DIVIDE_BY_ZERO);
+        r[in->a] = r[in->b] / r[in->c];
+        NEXT();
+
+do_nand:
+        r[in->a] = ~(r[in->b] & r[in->c]);
+        NEXT();
+
+do_halt:
+        /* Step past the HALT, so that it is counted */
+        halt(vm);
+        prog_counter++;
+        goto done;
+
+do_map:
+        map_segment(space, r, in->b, in->c, 0, false);
+        NEXT();
+
+do_unmap:
+        CHECK(r[in->c] != 0, FAILURE_UNMAP_ZERO);
+        CHECK(r[in->c] < space->num_segments &&
+              space->segments[r[in->c]] != NULL, FAILURE_UNMAPPED_SEGMENT);
+        FORGET_SEGMENT(r[in->c]);
+        unmap_segment(space, r, in->c);
+        NEXT();
+
+do_out:
+        CHECK(r[in->c] < 256, FAILURE_BAD_OUTPUT);
+        WAIT_FOR_OUTPUT();
+        put_output(out, (unsigned char)r[in->c]);
+        NEXT();
+
+do_in:
+        WAIT_FOR_INPUT();
+        input(input_buf, out, r, in->c);
+        NEXT();
+
+do_loadp:
+        /* A LOADP of a segment other than 0 replaces the 0 segment, so
+         * its decoded copy must be fetched again */
+        COUNT_LOADP(r[in->b] == 0);
+        if (r[in->b] != 0) {
+                CHECK(r[in->b] < space->num_segments &&
+                      space->segments[r[in->b]] != NULL,
+                      FAILURE_UNMAPPED_SEGMENT);
+                FORGET_SEGMENT(0);
+                END_RUN();
+                load_program(space, r, in->b, in->c, &prog_counter,
+                             &num_inst);
+                program = decoded_program(space);
+                PUBLISH_PROGRAM(r[in->b]);
+        } else {
+                END_RUN();
+                prog_counter = r[in->c];
+        }
+        START_RUN();
+        DISPATCH();
+
+do_lv:
+        r[in->a] = in->val;
+        NEXT();
+
+/* Each fused pair runs its first instruction from in and its second from
+ * the record after it, then continues after the pair */
+do_sload_add:
+        COUNT_FUSED(PAIR_SLOAD_ADD);
+        CHECK_WORD(r[in->b], r[in->c]);
+        COUNT_SEGMENT(r[in->b]);
+        r[in->a] = *unchecked_word(space, r[in->b], r[in->c]);
+        in++;
+        COUNT(ADD);
+        TICK_FUSED();
+        r[in->a] = r[in->b] + r[in->c];
+        prog_counter++;
+        NEXT();
+
+do_nand_nand:
+        COUNT_FUSED(PAIR_NAND_NAND);
+        r[in->a] = ~(r[in->b] & r[in->c]);
+        in++;
+        COUNT(NAND);
+        TICK_FUSED();
+        r[in->a] = ~(r[in->b] & r[in->c]);
+        prog_counter++;
+        NEXT();
+
+do_lv_add:
+        COUNT_FUSED(PAIR_LV_ADD);
+        r[in->a] = in->val;
+        in++;
+        COUNT(ADD);
+        TICK_FUSED();
+        r[in->a] = r[in->b] + r[in->c];
+        prog_counter++;
+        NEXT();
+
+do_lv_loadp:
+        /* Only a jump within the 0 segment is fused; a LOADP of another
+         * segment is dispatched on its own */
+        r[in->a] = in->val;
+        in++;
+        prog_counter++;
+        if (r[in->b] == 0) {
+                COUNT_FUSED(PAIR_LV_LOADP);
+                COUNT(LOADP);
+                COUNT_LOADP(true);
+                TICK_FUSED();
+                END_RUN();
+                prog_counter = r[in->c];
+                START_RUN();
+        }
+        DISPATCH();
+
+do_fail:
+        FAIL(FAILURE_BAD_INSTRUCTION);
+
+/* A failed instruction, or one a turn ended at, leaves the program
+ * counter at itself */
+failed:
+#if SCHEDULED
+yield:
+#endif
+        vm->prog_counter = (uint32_t)prog_counter;
+
+done:
+#if SCHEDULED
+        vm->prog_counter = (uint32_t)prog_counter;
+        vm->instructions = executed + (prog_counter - run_start);
+#endif
+        for (int i = 0; i < NUM_REGISTERS; i++) {
+                vm->registers[i] = r[i];
+        }
+
+#undef NEXT
+#undef DISPATCH
+}
+
+#undef COUNT
+#undef COUNT_LOADP
+#undef COUNT_FUSED
+#undef COUNT_SEGMENT
+#undef FORGET_SEGMENT
+#undef PUBLISH_PC
+#undef PUBLISH_PROGRAM
+#undef CHECKPOINT
+#undef TICK_FUSED
+#undef YIELD
+#undef END_RUN
+#undef START_RUN
+#undef WAIT_FOR_INPUT
+#undef WAIT_FOR_OUTPUT
+#undef END_TURN
+#undef HANDLER
+#undef FAIL
+#undef CHECK
+#undef CHECK_WORD
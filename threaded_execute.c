@@ -0,0 +1,211 @@
+/**************************************************************
+ *
+ *                     threaded_execute.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Implementation of the direct-threaded execution engine. Each
+ *              instruction handler ends with its own copy of the dispatch
+ *              sequence, which fetches the next instruction and jumps
+ *              straight to its handler through a table of label addresses.
+ *              Instructions are read from the decoded copy of the 0 segment,
+ *              the registers are copied into a local array for the duration
+ *              of the run, and the simple arithmetic instructions are
+ *              executed inline rather than through the operations module.
+ *              The engine itself is in threaded_engine.h, which is included
+ *              once each for the plain, trusted, profiling, checkpointing,
+ *              counting, scheduled and budgeted engines. Every engine but
+ *              the trusted one checks each segment access, division and
+ *              output and stops the machine with a reason when one fails.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include "threaded_execute.h"
+#include "read_and_execute.h"
+#include "operations.h"
+#include "segment_private.h"
+#include "stats.h"
+#include "profile.h"
+#include "checkpoint.h"
+
+#if defined(__GNUC__)
+
+/* Computed goto is a GNU extension, which -pedantic reports as an error */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+/* The engine used for ordinary runs, with no instrumentation */
+#define ENGINE_NAME execute_threaded
+#define COUNTING 0
+#define PROFILING 0
+#define CHECKPOINTING 0
+#define CHECKED 1
+#define SCHEDULED 0
+#define EXACT 0
+#include "threaded_engine.h"
+#undef ENGINE_NAME
+#undef COUNTING
+#undef PROFILING
+#undef CHECKPOINTING
+#undef CHECKED
+#undef SCHEDULED
+#undef EXACT
+
+/* The engine used for --trusted, with no instrumentation and no checks */
+#define ENGINE_NAME execute_threaded_trusted
+#define COUNTING 0
+#define PROFILING 0
+#define CHECKPOINTING 0
+#define CHECKED 0
+#define SCHEDULED 0
+#define EXACT 0
+#include "threaded_engine.h"
+#undef ENGINE_NAME
+#undef COUNTING
+#undef PROFILING
+#undef CHECKPOINTING
+#undef CHECKED
+#undef SCHEDULED
+#undef EXACT
+
+/* The engine used for --profile */
+#define ENGINE_NAME execute_threaded_profiling
+#define COUNTING 0
+#define PROFILING 1
+#define CHECKPOINTING 0
+#define CHECKED 1
+#define SCHEDULED 0
+#define EXACT 0
+#include "threaded_engine.h"
+#undef ENGINE_NAME
+#undef COUNTING
+#undef PROFILING
+#undef CHECKPOINTING
+#undef CHECKED
+#undef SCHEDULED
+#undef EXACT
+
+/* The engine used for --checkpoint, which can also be profiled */
+#define ENGINE_NAME execute_threaded_checkpointing
+#define COUNTING 0
+#define PROFILING 1
+#define CHECKPOINTING 1
+#define CHECKED 1
+#define SCHEDULED 0
+#define EXACT 0
+#include "threaded_engine.h"
+#undef ENGINE_NAME
+#undef COUNTING
+#undef PROFILING
+#undef CHECKPOINTING
+#undef CHECKED
+#undef SCHEDULED
+#undef EXACT
+
+/* The engine used for --stats and --fusion-report, which can also be
+ * profiled and checkpointed */
+#define ENGINE_NAME execute_threaded_counting
+#define COUNTING 1
+#define PROFILING 1
+#define CHECKPOINTING 1
+#define CHECKED 1
+#define SCHEDULED 0
+#define EXACT 0
+#include "threaded_engine.h"
+#undef ENGINE_NAME
+#undef COUNTING
+#undef PROFILING
+#undef CHECKPOINTING
+#undef CHECKED
+#undef SCHEDULED
+#undef EXACT
+
+/* The engine the scheduler runs machines on, a turn at a time */
+#define ENGINE_NAME execute_threaded_scheduled
+#define COUNTING 0
+#define PROFILING 0
+#define CHECKPOINTING 0
+#define CHECKED 1
+#define SCHEDULED 1
+#define EXACT 0
+#include "threaded_engine.h"
+#undef ENGINE_NAME
+#undef COUNTING
+#undef PROFILING
+#undef CHECKPOINTING
+#undef CHECKED
+#undef SCHEDULED
+#undef EXACT
+
+/* The engine libum runs machines on, for exactly as many instructions as
+ * the host asks */
+#define ENGINE_NAME execute_threaded_budgeted
+#define COUNTING 0
+#define PROFILING 0
+#define CHECKPOINTING 0
+#define CHECKED 1
+#define SCHEDULED 1
+#define EXACT 1
+#include "threaded_engine.h"
+#undef ENGINE_NAME
+#undef COUNTING
+#undef PROFILING
+#undef CHECKPOINTING
+#undef CHECKED
+#undef SCHEDULED
+#undef EXACT
+
+#pragma GCC diagnostic pop
+
+#else
+
+/*************** execute_threaded ***************
+ *
+ * Compilers without computed goto fall back on the switch-based engine,
+ * which does not count instructions, publish the program counter or write
+ * checkpoints, and runs a scheduled machine in a single turn.
+ *
+ ********************************************/
+extern void execute_threaded(Machine vm, size_t num_inst)
+{
+        execute_instructions(vm, num_inst);
+}
+
+extern void execute_threaded_trusted(Machine vm, size_t num_inst)
+{
+        execute_instructions(vm, num_inst);
+}
+
+extern void execute_threaded_profiling(Machine vm, size_t num_inst)
+{
+        execute_instructions(vm, num_inst);
+}
+
+extern void execute_threaded_checkpointing(Machine vm, size_t num_inst)
+{
+        execute_instructions(vm, num_inst);
+}
+
+extern void execute_threaded_counting(Machine vm, size_t num_inst)
+{
+        execute_instructions(vm, num_inst);
+}
+
+extern void execute_threaded_scheduled(Machine vm, size_t num_inst)
+{
+        execute_instructions(vm, num_inst);
+        vm->state = MACHINE_STOPPED;
+}
+
+extern void execute_threaded_budgeted(Machine vm, size_t num_inst)
+{
+        execute_instructions(vm, num_inst);
+        vm->state = MACHINE_STOPPED;
+}
+
+#endif
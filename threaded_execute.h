@@ -0,0 +1,44 @@
+/**************************************************************
+ *
+ *                     threaded_execute.h
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Function declaration for the direct-threaded execution
+ *              engine. This engine executes the same instructions as
+ *              execute_instructions, but dispatches each instruction with a
+ *              computed goto instead of a switch statement. The trusted
+ *              variant makes no checks on the program, the profiling
+ *              variant also publishes the program counter for the sampling
+ *              profiler, the checkpointing variant also writes checkpoints,
+ *              and the counting variant does all of these and also counts
+ *              every instruction into the machine's Um_stats. The scheduled
+ *              variant runs a machine for one turn, which ends after
+ *              vm->quantum instructions or at an input or output
+ *              instruction that would wait, and the budgeted variant does
+ *              the same but ends the turn after exactly vm->quantum
+ *              instructions.
+ *
+ **************************************************************/
+
+#ifndef THREADED_EXECUTE_H
+#define THREADED_EXECUTE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "machine.h"
+
+/*****************************************************************
+ *                  Program Function Declarations
+ *****************************************************************/
+extern void execute_threaded(Machine vm, size_t num_inst);
+extern void execute_threaded_trusted(Machine vm, size_t num_inst);
+extern void execute_threaded_profiling(Machine vm, size_t num_inst);
+extern void execute_threaded_checkpointing(Machine vm, size_t num_inst);
+extern void execute_threaded_counting(Machine vm, size_t num_inst);
+extern void execute_threaded_scheduled(Machine vm, size_t num_inst);
+extern void execute_threaded_budgeted(Machine vm, size_t num_inst);
+
+#endif
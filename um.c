@@ -15,11 +15,18 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include "read_and_execute.h"
+#include "image.h"
+#include "batch.h"
+#include "mem.h"
 
-/* Declaration for open_or_die function */
+/* Declaration for open_or_die and usage functions */
 static FILE *open_or_die(char *fname, char *mode);
+static void usage(char *prog_name);
+static char *image_name(const char *fname);
 
 /****************** main *******************
  * 
@@ -37,6 +44,33 @@ static FILE *open_or_die(char *fname, char *mode);
  * Notes:
  *      If the program is not passed the correct number of arguments, it will
  *      print a usage message and exit with a failure status.
+ *      The option --engine=switch, --engine=threaded or --engine=jit selects
+ *      the execution engine; otherwise the engine chosen at build time is used.
+ *      The option --output=line, --output=full or --output=null writes the
+ *      program's output after every newline, only when the buffer fills, or
+ *      never; otherwise line mode is used when stdout is a terminal. The option
+ *      --stats prints execution counters as JSON on stderr, and the option
+ *      --fusion-report prints how many instructions ran as fused pairs;
+ *      either one runs the program on the counting engine. The option
+ *      --profile samples the program counter and prints the hottest ranges
+ *      of the program on stderr. The option --checkpoint=<file> writes the
+ *      machine to that file whenever um receives SIGUSR1 and, with
+ *      --checkpoint-at=<count>, once that many instructions have run. Both
+ *      always run the program on a copy of the checked threaded engine, so
+ *      they are refused with --trusted or with an --engine other than
+ *      threaded rather than quietly running another engine. The
+ *      option --restore=<file> takes the place of the program file and
+ *      starts from the checkpoint. The option --compile writes the program
+ *      to a pre-decoded image, named by -o <file> or else after the program
+ *      with the extension .umc, instead of running it; a program file that
+ *      is such an image is mapped and run without being decoded again.
+ *      The option --batch <file> runs every job listed in the file on -j
+ *      <count> worker threads (one per processor by default) instead of a
+ *      single program, or with --quantum=<count> interleaves them all on one
+ *      thread, giving each that many instructions at a time. The threaded
+ *      engine checks every instruction and stops a program that fails with an
+ *      error message and a failure status; the option --trusted runs it
+ *      without those checks instead, for programs known to be correct.
  *      The file is opened but not closed in this function and thus, it is
  *      expected for the file to be closed elsewhere.
  *
@@ -47,11 +81,113 @@ int main(int argc, char *argv[])
         struct stat statistics;
         size_t size_in_bytes;
 
+        /* How to run the program and the name of the program file */
+        Um_options options = { DEFAULT_ENGINE, OUTPUT_DEFAULT, false, false,
+                                false, NULL, 0, NULL, NULL, false, 0 };
+        char *fname = NULL;
+        bool compile = false;
+        char *image = NULL;
+        char *jobs = NULL;
+        bool engine_given = false;
+        int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+        /* Sort the arguments into options and the program file name */
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "--engine=switch") == 0) {
+                        options.engine = SWITCH_ENGINE;
+                        engine_given = true;
+                } else if (strcmp(argv[i], "--engine=threaded") == 0) {
+                        options.engine = THREADED_ENGINE;
+                        engine_given = true;
+                } else if (strcmp(argv[i], "--engine=jit") == 0) {
+                        options.engine = JIT_ENGINE;
+                        engine_given = true;
+                } else if (strcmp(argv[i], "--stats") == 0) {
+                        options.stats = true;
+                } else if (strcmp(argv[i], "--trusted") == 0) {
+                        options.trusted = true;
+                } else if (strcmp(argv[i], "--profile") == 0) {
+                        options.profile = true;
+                } else if (strcmp(argv[i], "--fusion-report") == 0) {
+                        options.report_fusion = true;
+                } else if (strncmp(argv[i], "--checkpoint=", 13) == 0) {
+                        options.checkpoint = argv[i] + 13;
+                } else if (strncmp(argv[i], "--checkpoint-at=", 16) == 0) {
+                        options.checkpoint_at = strtoull(argv[i] + 16, NULL,
+                                                         10);
+                } else if (strncmp(argv[i], "--restore=", 10) == 0) {
+                        options.restore = argv[i] + 10;
+                } else if (strcmp(argv[i], "--compile") == 0) {
+                        compile = true;
+                } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                        image = argv[++i];
+                } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+                        jobs = argv[++i];
+                } else if (strncmp(argv[i], "--quantum=", 10) == 0) {
+                        options.quantum = strtoull(argv[i] + 10, NULL, 10);
+                        if (options.quantum == 0) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+                        num_workers = atoi(argv[++i]);
+                        if (num_workers < 1) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--output=line") == 0) {
+                        options.output_mode = OUTPUT_LINE;
+                } else if (strcmp(argv[i], "--output=full") == 0) {
+                        options.output_mode = OUTPUT_FULL;
+                } else if (strcmp(argv[i], "--output=null") == 0) {
+                        options.output_mode = OUTPUT_NULL;
+                } else if (argv[i][0] != '-' && fname == NULL) {
+                        fname = argv[i];
+                } else {
+                        usage(argv[0]);
+                }
+        }
+
+        /* Profiles and checkpoints are only taken by the threaded engine */
+        if ((options.profile || options.checkpoint != NULL) &&
+            (options.trusted ||
+             (engine_given && options.engine != THREADED_ENGINE))) {
+                usage(argv[0]);
+        }
+
         /* Check for correct argument usage */
-        if (argc == 2) {
+        if (jobs != NULL) {
+                /* Run every job in the file instead of one program */
+                if (fname != NULL || compile || image != NULL ||
+                    options.restore != NULL || options.checkpoint != NULL ||
+                    options.profile) {
+                        usage(argv[0]);
+                }
+                return run_batch(jobs, num_workers > 0 ? num_workers : 1,
+                                 options);
+        } else if (options.quantum > 0) {
+                /* Only batch jobs are interleaved */
+                usage(argv[0]);
+        } else if (compile || image != NULL) {
+                /* Write the program to an image instead of running it */
+                if (!compile || fname == NULL || options.restore != NULL) {
+                        usage(argv[0]);
+                }
+                char *default_name = image == NULL ? image_name(fname) : NULL;
+                compile_image(fname, image == NULL ? default_name : image);
+                if (default_name != NULL) {
+                        FREE(default_name);
+                }
+        } else if (options.restore != NULL && fname == NULL) {
+                /* The program comes from the checkpoint */
+                return um_driver(NULL, 0, options);
+        } else if (fname != NULL && options.restore == NULL &&
+                   is_image(fname)) {
+                /* The program and its decoded records come from the image */
+                options.image = fname;
+                return um_driver(NULL, 0, options);
+        } else if (fname != NULL && options.restore == NULL) {
                 /* Populates the stat stuct according to file and returns
                  * 0 if successful */
-                if (stat(argv[1], &statistics) == 0) {
+                if (stat(fname, &statistics) == 0) {
                         size_in_bytes = statistics.st_size;
 
                         /* Check if the file size is a multiple of 4 bytes */
@@ -60,21 +196,74 @@ int main(int argc, char *argv[])
                                 size_t num_inst = size_in_bytes / 4;
 
                                 /* Open the file */
-                                FILE *fp = open_or_die(argv[1], "r");
+                                FILE *fp = open_or_die(fname, "r");
 
                                 /* Read in and execute the instructions */
-                                um_driver(fp, num_inst);
+                                return um_driver(fp, num_inst, options);
                         }
                 }
         } else {
                 /* Print usage message and exit with failure status */
-                fprintf(stderr, "Usage: %s <filename>\n", argv[0]);
-                exit(EXIT_FAILURE);
+                usage(argv[0]);
         }
 
         return EXIT_SUCCESS;
 }
 
+/****************** usage *******************
+ * 
+ * Prints a usage message to stderr and exits with a failure status.
+ *
+ * Parameters:
+ *      char *prog_name: name the program was invoked with
+ * Returns:
+ *      None.
+ * Expects:
+ *      None
+ *
+ ********************************************/
+static void usage(char *prog_name)
+{
+        fprintf(stderr, "Usage: %s [--engine=switch|threaded|jit] "
+                        "[--output=line|full|null] [--trusted] [--stats] "
+                        "[--fusion-report] [--profile] "
+                        "[--checkpoint=<file> [--checkpoint-at=<count>]] "
+                        "<filename | --restore=<file>>\n"
+                        "       %s --compile <filename> [-o <image>]\n"
+                        "       %s [--engine=...] [--trusted] [--stats] "
+                        "--batch <jobs> [-j <count> | --quantum=<count>]\n",
+                        prog_name, prog_name, prog_name);
+        exit(EXIT_FAILURE);
+}
+
+/****************** image_name *******************
+ * 
+ * Names the image of a program after it, with its extension replaced by
+ * .umc.
+ *
+ * Parameters:
+ *      const char *fname: name of the program file
+ * Returns:
+ *      the name of the image, which the caller must free
+ * Expects:
+ *      fname is not NULL
+ *
+ ********************************************/
+static char *image_name(const char *fname)
+{
+        size_t length = strlen(fname);
+        const char *dot = strrchr(fname, '.');
+        const char *slash = strrchr(fname, '/');
+        if (dot != NULL && dot != fname && (slash == NULL || dot > slash + 1)) {
+                length = (size_t)(dot - fname);
+        }
+
+        char *name = ALLOC(length + sizeof(".umc"));
+        memcpy(name, fname, length);
+        memcpy(name + length, ".umc", sizeof(".umc"));
+        return name;
+}
+
 /************** FILE *open_or_die *************
  * 
  * Opens a file or exits with an error message if the file cannot be opened.
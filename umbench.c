@@ -0,0 +1,388 @@
+/**************************************************************
+ *
+ *                     umbench.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Benchmark driver used by "make bench". For every program
+ *              given, it counts the instructions the program executes with
+ *              one run of "um --stats", then times several plain runs and
+ *              reports the median wall time, the throughput in millions of
+ *              instructions per second, and the peak resident set size.
+ *              The throughput is compared with a baseline file, and the
+ *              driver fails if any program is slower than its baseline by
+ *              more than a given percentage.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/* Most timed runs of one program, and most programs in one baseline */
+#define MAX_RUNS 101
+#define MAX_BASELINE 1024
+
+/* Programs that execute fewer instructions than this are reported but not
+ * compared with the baseline, since process startup dominates their time */
+#define MIN_GATED_INSTRUCTIONS 10000000ULL
+
+/********** Bench_result ********
+ *
+ * Struct to hold the measurements of one program.
+ *
+ *******************/
+typedef struct Bench_result {
+        const char *program;          /* path of the program */
+        unsigned long long executed;  /* instructions it executes */
+        double seconds;               /* median wall time of the runs */
+        double mips;                  /* executed / seconds, in millions */
+        long peak_rss;                /* largest resident set, in KB */
+} Bench_result;
+
+/********** Baseline_entry ********
+ *
+ * One line of the baseline file: a program and its expected throughput.
+ *
+ *******************/
+typedef struct Baseline_entry {
+        char program[256];
+        double mips;
+} Baseline_entry;
+
+/* Declarations for the helpers */
+static void usage(const char *prog_name);
+static pid_t run_um(const char *um, const char *program, bool stats,
+                    int stderr_fd);
+static unsigned long long count_instructions(const char *um,
+                                             const char *program);
+static Bench_result measure(const char *um, const char *program, int runs);
+static int read_baseline(const char *path, Baseline_entry *entries);
+static int compare_doubles(const void *a, const void *b);
+
+/****************** main *******************
+ *
+ * Measures every program given on the command line and reports the
+ * results, comparing them with or writing them to a baseline file.
+ *
+ * Parameters:
+ *         int argc:   number of arguments passed into the program
+ *      char *argv[]:  the options, then the paths of the programs
+ * Returns:
+ *      EXIT_SUCCESS, or EXIT_FAILURE if a program regressed or failed
+ * Expects:
+ *      Options are -u um_path (default ./um), -n runs (default 5),
+ *      -b baseline to compare with, -t tolerance in percent (default 10)
+ *      and -w baseline to write.
+ * Notes:
+ *      A program that reads input is given the file with the same name and
+ *      the extension .0 on stdin if there is one, and /dev/null otherwise,
+ *      as process_files.sh does.
+ *
+ ********************************************/
+int main(int argc, char *argv[])
+{
+        const char *um = "./um";
+        const char *baseline_path = NULL;
+        const char *write_path = NULL;
+        int runs = 5;
+        double tolerance = 10.0;
+
+        int opt;
+        while ((opt = getopt(argc, argv, "u:n:b:t:w:")) != -1) {
+                switch (opt) {
+                case 'u': um = optarg; break;
+                case 'n': runs = atoi(optarg); break;
+                case 'b': baseline_path = optarg; break;
+                case 't': tolerance = atof(optarg); break;
+                case 'w': write_path = optarg; break;
+                default: usage(argv[0]);
+                }
+        }
+        if (runs < 1 || runs > MAX_RUNS || optind >= argc) {
+                usage(argv[0]);
+        }
+
+        static Baseline_entry baseline[MAX_BASELINE];
+        int baseline_size = 0;
+        if (baseline_path != NULL) {
+                baseline_size = read_baseline(baseline_path, baseline);
+        }
+
+        FILE *out = NULL;
+        if (write_path != NULL) {
+                out = fopen(write_path, "w");
+                if (out == NULL) {
+                        perror(write_path);
+                        exit(EXIT_FAILURE);
+                }
+                fprintf(out, "# program MIPS, written by umbench from the "
+                             "median of %d runs\n", runs);
+        }
+
+        printf("%-32s %14s %10s %9s %10s  %s\n", "program", "instructions",
+               "median s", "MIPS", "peak KB", "vs baseline");
+
+        bool failed = false;
+        for (int i = optind; i < argc; i++) {
+                Bench_result result = measure(um, argv[i], runs);
+                if (result.executed == 0) {
+                        printf("%-32s failed to run\n", argv[i]);
+                        failed = true;
+                        continue;
+                }
+                printf("%-32s %14llu %10.4f %9.2f %10ld  ", result.program,
+                       result.executed, result.seconds, result.mips,
+                       result.peak_rss);
+
+                /* Compare with the baseline entry for the program */
+                const Baseline_entry *entry = NULL;
+                for (int j = 0; j < baseline_size; j++) {
+                        if (strcmp(baseline[j].program, argv[i]) == 0) {
+                                entry = &baseline[j];
+                        }
+                }
+                if (entry == NULL || entry->mips <= 0) {
+                        printf("no baseline\n");
+                } else if (result.executed < MIN_GATED_INSTRUCTIONS) {
+                        printf("%+.1f%% (too short to gate)\n",
+                               100.0 * (result.mips / entry->mips - 1));
+                } else {
+                        double change = 100.0 * (result.mips / entry->mips
+                                                 - 1);
+                        bool regressed = change < -tolerance;
+                        printf("%+.1f%%%s\n", change,
+                               regressed ? "  REGRESSION" : "");
+                        failed = failed || regressed;
+                }
+
+                if (out != NULL) {
+                        fprintf(out, "%s %g\n", argv[i], result.mips);
+                }
+        }
+
+        if (out != NULL) {
+                fclose(out);
+        }
+        if (failed) {
+                fprintf(stderr, "umbench: throughput regressed by more "
+                                "than %.1f%%, or a program failed\n",
+                        tolerance);
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
+
+/****************** usage *******************
+ *
+ * Prints a usage message to stderr and exits with a failure status.
+ *
+ ********************************************/
+static void usage(const char *prog_name)
+{
+        fprintf(stderr, "Usage: %s [-u um] [-n runs] [-b baseline] "
+                        "[-t percent] [-w baseline] program...\n",
+                prog_name);
+        exit(EXIT_FAILURE);
+}
+
+/****************** run_um *******************
+ *
+ * Starts um on the given program with its output thrown away.
+ *
+ * Parameters:
+ *      const char *um:      path of the um executable
+ *      const char *program: path of the program to run
+ *      bool stats:          whether to pass --stats
+ *      int stderr_fd:       descriptor for um's stderr, or -1 to discard it
+ * Returns:
+ *      the process ID of um, or -1 if it could not be started
+ * Expects:
+ *      um and program are not NULL.
+ *
+ ********************************************/
+static pid_t run_um(const char *um, const char *program, bool stats,
+                    int stderr_fd)
+{
+        /* Input comes from the program's .0 file if it has one */
+        char input[4096];
+        snprintf(input, sizeof(input), "%s", program);
+        char *dot = strrchr(input, '.');
+        if (dot != NULL && strchr(dot, '/') == NULL) {
+                strcpy(dot, ".0");
+        }
+        if (access(input, R_OK) != 0) {
+                strcpy(input, "/dev/null");
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+                int in = open(input, O_RDONLY);
+                int null = open("/dev/null", O_WRONLY);
+                dup2(in, STDIN_FILENO);
+                dup2(null, STDOUT_FILENO);
+                dup2(stderr_fd >= 0 ? stderr_fd : null, STDERR_FILENO);
+                if (stats) {
+                        execl(um, um, "--stats", program, (char *)NULL);
+                } else {
+                        execl(um, um, program, (char *)NULL);
+                }
+                _exit(127);
+        }
+        return pid;
+}
+
+/****************** count_instructions *******************
+ *
+ * Counts the instructions the given program executes by running it once
+ * with --stats and reading the count from the JSON on stderr.
+ *
+ * Parameters:
+ *      const char *um:      path of the um executable
+ *      const char *program: path of the program to run
+ * Returns:
+ *      the number of instructions executed, or 0 if um failed
+ * Expects:
+ *      um and program are not NULL.
+ *
+ ********************************************/
+static unsigned long long count_instructions(const char *um,
+                                             const char *program)
+{
+        int fds[2];
+        if (pipe(fds) != 0) {
+                return 0;
+        }
+        pid_t pid = run_um(um, program, true, fds[1]);
+        close(fds[1]);
+
+        /* The count is the first field of the JSON object */
+        char report[4096];
+        size_t length = 0;
+        ssize_t n;
+        while ((n = read(fds[0], report + length,
+                         sizeof(report) - 1 - length)) > 0) {
+                length += n;
+        }
+        close(fds[0]);
+        report[length] = '\0';
+
+        int status;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+                return 0;
+        }
+
+        const char *field = strstr(report, "\"instructions\": ");
+        if (field == NULL) {
+                return 0;
+        }
+        return strtoull(field + strlen("\"instructions\": "), NULL, 10);
+}
+
+/****************** measure *******************
+ *
+ * Counts the instructions the given program executes, then runs it the
+ * given number of times and keeps the median wall time and peak memory.
+ *
+ * Parameters:
+ *      const char *um:      path of the um executable
+ *      const char *program: path of the program to run
+ *      int runs:            number of timed runs
+ * Returns:
+ *      the measurements, with executed set to 0 if any run failed
+ * Expects:
+ *      0 < runs <= MAX_RUNS.
+ *
+ ********************************************/
+static Bench_result measure(const char *um, const char *program, int runs)
+{
+        Bench_result result = { program, 0, 0.0, 0.0, 0 };
+        unsigned long long executed = count_instructions(um, program);
+        if (executed == 0) {
+                return result;
+        }
+
+        double times[MAX_RUNS];
+        for (int i = 0; i < runs; i++) {
+                struct timespec start, end;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                pid_t pid = run_um(um, program, false, -1);
+
+                int status;
+                struct rusage usage;
+                if (pid < 0 || wait4(pid, &status, 0, &usage) < 0 ||
+                    !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                        return result;
+                }
+                clock_gettime(CLOCK_MONOTONIC, &end);
+
+                times[i] = (end.tv_sec - start.tv_sec) +
+                           (end.tv_nsec - start.tv_nsec) / 1e9;
+                if (usage.ru_maxrss > result.peak_rss) {
+                        result.peak_rss = usage.ru_maxrss;
+                }
+        }
+
+        qsort(times, runs, sizeof(double), compare_doubles);
+        result.executed = executed;
+        result.seconds = runs % 2 == 1 ? times[runs / 2] :
+                         (times[runs / 2 - 1] + times[runs / 2]) / 2;
+        result.mips = executed / result.seconds / 1e6;
+        return result;
+}
+
+/****************** read_baseline *******************
+ *
+ * Reads a baseline file of "program MIPS" lines, skipping lines that start
+ * with '#'.
+ *
+ * Parameters:
+ *      const char *path:         path of the baseline file
+ *      Baseline_entry *entries:  array of MAX_BASELINE entries to fill
+ * Returns:
+ *      the number of entries read, 0 if the file does not exist
+ * Expects:
+ *      path and entries are not NULL.
+ *
+ ********************************************/
+static int read_baseline(const char *path, Baseline_entry *entries)
+{
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) {
+                return 0;
+        }
+
+        int count = 0;
+        char line[512];
+        while (count < MAX_BASELINE && fgets(line, sizeof(line), fp)) {
+                if (line[0] != '#' &&
+                    sscanf(line, "%255s %lf", entries[count].program,
+                           &entries[count].mips) == 2) {
+                        count++;
+                }
+        }
+        fclose(fp);
+        return count;
+}
+
+/****************** compare_doubles *******************
+ *
+ * qsort comparison that orders doubles from smallest to largest.
+ *
+ ********************************************/
+static int compare_doubles(const void *a, const void *b)
+{
+        double x = *(const double *)a;
+        double y = *(const double *)b;
+        return (x > y) - (x < y);
+}
@@ -15,6 +15,7 @@
  
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <assert.h>
 #include <seq.h>
@@ -525,4 +526,414 @@ void load_test_not_0(Seq_T stream)
 
         append(stream, loadval(r0, 87));
         append(stream, loadp(r2, r7)); /* load 0 segment at 0th word */
-}
\ No newline at end of file
+}
+
+/* Appends the instructions to store a whole word at the given index of the
+ * segment whose ID is in register seg. Uses r4, r5 and r6 */
+static void store_word(Seq_T stream, Um_register seg, uint32_t index,
+                       Um_instruction word)
+{
+        append(stream, loadval(r5, word >> 16));
+        append(stream, loadval(r6, 1 << 16));
+        append(stream, multiply(r5, r5, r6));
+        append(stream, loadval(r6, word & 0xFFFF));
+        append(stream, add(r5, r5, r6));
+        append(stream, loadval(r4, index));
+        append(stream, sstore(seg, r4, r5));
+}
+
+/* expected output: AB */
+void loadp_cow_test(Seq_T stream)
+{
+        /* map a 7-long segment, whose ID is in r2 */
+        append(stream, loadval(r3, 7));
+        append(stream, activate(r2, r3));
+
+        /* code for the segment: overwrite the A at index 6 of the 0 segment
+         * with a B, then output index 6 of the segment that was loaded,
+         * which must still be A, and of the 0 segment */
+        store_word(stream, r2, 0, sstore(r0, r1, r3));
+        store_word(stream, r2, 1, sload(r5, r2, r1));
+        store_word(stream, r2, 2, output(r5));
+        store_word(stream, r2, 3, sload(r5, r0, r1));
+        store_word(stream, r2, 4, output(r5));
+        store_word(stream, r2, 5, halt());
+        store_word(stream, r2, 6, 'A');
+
+        append(stream, loadval(r0, 0));
+        append(stream, loadval(r1, 6));
+        append(stream, loadval(r3, 'B'));
+        append(stream, loadp(r2, r0)); /* load the segment at its 0th word */
+}
+
+/* expected output: X0 */
+void remap_test(Seq_T stream)
+{
+        /* map a 4-long segment, whose ID is in r2, and store an X at
+         * index 2 */
+        append(stream, loadval(r3, 4));
+        append(stream, activate(r2, r3));
+        append(stream, loadval(r1, 2));
+        append(stream, loadval(r0, 'X'));
+        append(stream, sstore(r2, r1, r0));
+
+        append(stream, sload(r5, r2, r1));
+        append(stream, output(r5));
+
+        /* unmap it and map another, which gets the same ID, into r4. Its
+         * words must be 0, so index 2 plus '0' outputs a 0 */
+        append(stream, inactivate(r2));
+        append(stream, activate(r4, r3));
+        append(stream, sload(r5, r4, r1));
+        append(stream, loadval(r6, '0'));
+        append(stream, add(r5, r5, r6));
+        append(stream, output(r5));
+
+        append(stream, halt());
+}
+
+/* expected output: JJ */
+void sstore_0_test(Seq_T stream)
+{
+        append(stream, loadval(r0, 0));
+        append(stream, loadval(r2, 1));
+
+        /* overwrite the add after the store_word with an output of r1. The
+         * store_word is 7 instructions long and the add follows the load of
+         * the J into r1, so the two would run fused if they were not
+         * decoded again */
+        uint32_t target = Seq_length(stream) + 7 + 1;
+        store_word(stream, r0, target, output(r1));
+
+        append(stream, loadval(r1, 'J'));
+        append(stream, add(r1, r1, r2)); /* outputs J instead of making K */
+        append(stream, output(r1));
+        append(stream, halt());
+}
+
+/* Appends, or with seg stores at index 7 of the segment in seg, a loop
+ * that adds step to r3 once for each count in r7, going to the index in r6
+ * when r7 reaches 0. It is 6 instructions long and expects r0 to be 0, r5
+ * to be 0xFFFFFFFF and r2 to hold where the loop starts */
+static void jit_loop(Seq_T stream, Um_register seg, bool stored,
+                     unsigned step)
+{
+        Um_instruction loop[] = {
+                loadval(r1, step), add(r3, r3, r1), add(r7, r7, r5),
+                add(r4, r6, r0), cmov(r4, r2, r7), loadp(r0, r4)
+        };
+        for (unsigned i = 0; i < sizeof(loop) / sizeof(loop[0]); i++) {
+                if (stored) {
+                        store_word(stream, seg, 7 + i, loop[i]);
+                } else {
+                        append(stream, loop[i]);
+                }
+        }
+}
+
+/* expected output: fB (run with --engine=jit) */
+void jit_flush_test(Seq_T stream)
+{
+        /* run the loop at index 7 34 times, enough for it to be compiled,
+         * adding 1 each time */
+        append(stream, loadval(r0, 0));
+        append(stream, nand(r5, r0, r0));
+        append(stream, loadval(r3, 0));
+        append(stream, loadval(r7, 34));
+        append(stream, loadval(r2, 7));
+        append(stream, loadval(r6, 13));
+        append(stream, loadp(r0, r2));
+        jit_loop(stream, r0, false, 1);
+
+        /* store over the first instruction of the compiled loop so that it
+         * adds 2, and run it 34 more times, compiling it again: 34 + 68 is
+         * an f */
+        store_word(stream, r0, 7, loadval(r1, 2));
+        append(stream, nand(r5, r0, r0));
+        append(stream, loadval(r7, 34));
+        append(stream, loadval(r6, 24));
+        append(stream, loadp(r0, r2));
+        append(stream, output(r3));
+
+        /* load a shorter program whose loop adding 3 is also at index 7
+         * and run it 22 times, which must not reuse the old compiled loop:
+         * 66 is a B */
+        append(stream, loadval(r6, 15));
+        append(stream, activate(r1, r6));
+        jit_loop(stream, r1, true, 3);
+        store_word(stream, r1, 13, output(r3));
+        store_word(stream, r1, 14, halt());
+        append(stream, nand(r5, r0, r0));
+        append(stream, loadval(r3, 0));
+        append(stream, loadval(r7, 22));
+        append(stream, loadval(r6, 13));
+        append(stream, loadp(r1, r2));
+}
+
+/* Synthetic workloads for benchmarking
+ *
+ * Each generator appends a whole program to an empty stream and returns
+ * the exact number of instructions the program executes, counting the
+ * final halt, so a benchmark can compute MIPS from the wall time alone.
+ * The loops share a layout: r0 holds 0, r7 holds all ones (so adding r7
+ * subtracts 1), r1 counts the iterations left, and r2 and r5 are clobbered
+ * by the branch at the bottom of each loop. Values loaded with loadval
+ * must fit in 25 bits, so a larger iteration count is built from two
+ * halves with a multiply and an add.
+ */
+
+#define LOADVAL_LIMIT (1u << 25)
+
+/* Returns the number of instructions loop_head appends for a count */
+static uint32_t loop_head_length(uint32_t iterations)
+{
+        return iterations < LOADVAL_LIMIT ? 3 : 7;
+}
+
+/* Appends the setup shared by the loops, which also clobbers r2 when the
+ * count does not fit in a loadval, and returns its length */
+static uint32_t loop_head(Seq_T stream, uint32_t iterations)
+{
+        assert(iterations > 0);
+        append(stream, loadval(r0, 0));
+        append(stream, nand(r7, r0, r0));
+        if (iterations < LOADVAL_LIMIT) {
+                append(stream, loadval(r1, iterations));
+        } else {
+                append(stream, loadval(r1, iterations >> 16));
+                append(stream, loadval(r2, 1 << 16));
+                append(stream, multiply(r1, r1, r2));
+                append(stream, loadval(r2, iterations & 0xFFFF));
+                append(stream, add(r1, r1, r2));
+        }
+        return loop_head_length(iterations);
+}
+
+/* Appends the bottom of a loop: counts r1 down and goes back to top unless
+ * it reached 0, in which case execution falls through. 5 instructions */
+static void loop_tail(Seq_T stream, uint32_t top)
+{
+        uint32_t exit = Seq_length(stream) + 5;
+        append(stream, add(r1, r1, r7));
+        append(stream, loadval(r5, exit));
+        append(stream, loadval(r2, top));
+        append(stream, cmov(r5, r2, r1));
+        append(stream, loadp(r0, r5));
+}
+
+/* Arithmetic-heavy loop: each iteration runs the given numbers of adds,
+ * multiplies, divides and nands on r3 and r4, with r6 holding 3 */
+uint64_t build_arith_workload(Seq_T stream, uint32_t iterations,
+                              unsigned adds, unsigned muls, unsigned divs,
+                              unsigned nands)
+{
+        assert(Seq_length(stream) == 0);
+        uint32_t head = loop_head(stream, iterations);
+        append(stream, loadval(r6, 3));
+        append(stream, loadval(r3, 1));
+
+        uint32_t top = Seq_length(stream);
+        for (unsigned i = 0; i < adds; i++) {
+                append(stream, add(r3, r3, r6));
+        }
+        for (unsigned i = 0; i < muls; i++) {
+                append(stream, multiply(r4, r3, r6));
+        }
+        for (unsigned i = 0; i < divs; i++) {
+                append(stream, divide(r4, r3, r6));
+        }
+        for (unsigned i = 0; i < nands; i++) {
+                append(stream, nand(r4, r3, r4));
+        }
+        loop_tail(stream, top);
+        append(stream, halt());
+
+        uint64_t body = adds + muls + divs + nands + 5;
+        return head + 2 + (uint64_t)iterations * body + 1;
+}
+
+/* MAP/UNMAP churn: keeps one live segment for each entry of lengths, with
+ * their IDs in a table segment held in r6, and on each iteration unmaps
+ * every live segment and maps a new one of the same length in its place.
+ * Repeating a length in the array makes it more frequent */
+uint64_t build_churn_workload(Seq_T stream, uint32_t iterations,
+                              const uint32_t *lengths, unsigned num_lengths)
+{
+        assert(Seq_length(stream) == 0 && num_lengths > 0);
+        uint32_t head = loop_head(stream, iterations);
+        append(stream, loadval(r5, num_lengths));
+        append(stream, activate(r6, r5));
+
+        for (unsigned i = 0; i < num_lengths; i++) {
+                assert(lengths[i] < LOADVAL_LIMIT);
+                append(stream, loadval(r4, i));
+                append(stream, loadval(r5, lengths[i]));
+                append(stream, activate(r3, r5));
+                append(stream, sstore(r6, r4, r3));
+        }
+
+        uint32_t top = Seq_length(stream);
+        for (unsigned i = 0; i < num_lengths; i++) {
+                append(stream, loadval(r4, i));
+                append(stream, sload(r3, r6, r4));
+                append(stream, inactivate(r3));
+                append(stream, loadval(r5, lengths[i]));
+                append(stream, activate(r3, r5));
+                append(stream, sstore(r6, r4, r3));
+        }
+        loop_tail(stream, top);
+        append(stream, halt());
+
+        return head + 2 + 4 * (uint64_t)num_lengths +
+               (uint64_t)iterations * (6 * num_lengths + 5) + 1;
+}
+
+/* Random SLOAD/SSTORE over one segment of 2^log_length words, held in r6.
+ * Every access steps a linear congruential generator in r3 (multiply by
+ * 1664525, subtract 1) and uses its top log_length bits as the index.
+ * Loads go to r5 and stores write the generator's value */
+uint64_t build_memory_workload(Seq_T stream, uint32_t iterations,
+                               unsigned log_length, unsigned loads,
+                               unsigned stores)
+{
+        assert(Seq_length(stream) == 0);
+        assert(log_length >= 8 && log_length <= 24);
+        uint32_t head = loop_head(stream, iterations);
+        append(stream, loadval(r5, 1u << log_length));
+        append(stream, activate(r6, r5));
+        append(stream, loadval(r3, 1));
+
+        uint32_t top = Seq_length(stream);
+        for (unsigned i = 0; i < loads + stores; i++) {
+                append(stream, loadval(r2, 1664525));
+                append(stream, multiply(r3, r3, r2));
+                append(stream, add(r3, r3, r7));
+                append(stream, loadval(r2, 1u << (32 - log_length)));
+                append(stream, divide(r4, r3, r2));
+                if (i < loads) {
+                        append(stream, sload(r5, r6, r4));
+                } else {
+                        append(stream, sstore(r6, r4, r3));
+                }
+        }
+        loop_tail(stream, top);
+        append(stream, halt());
+
+        return head + 3 + (uint64_t)iterations * (6 * (loads + stores) + 5) +
+               1;
+}
+
+/* LOADP-heavy code: copies num_blocks blocks of code out of segment 0 into
+ * their own segments, with their IDs in a table segment held in r6, then
+ * jumps into the first. Each block runs body adds and then loads the next
+ * block as the 0 segment; the last one counts the iteration and either
+ * loads the first block again or jumps to its own halt */
+uint64_t build_loadp_workload(Seq_T stream, uint32_t iterations,
+                              unsigned num_blocks, unsigned body)
+{
+        assert(Seq_length(stream) == 0 && num_blocks > 0);
+
+        /* Lay out the blocks first, since the copy loop needs their
+         * lengths and where they sit in segment 0 */
+        Seq_T blocks = Seq_new(0);
+        uint32_t block_start[num_blocks + 1];
+        for (unsigned i = 0; i < num_blocks; i++) {
+                block_start[i] = Seq_length(blocks);
+                for (unsigned j = 0; j < body; j++) {
+                        append(blocks, add(r3, r3, r7));
+                }
+                if (i + 1 < num_blocks) {
+                        append(blocks, loadval(r4, i + 1));
+                        append(blocks, sload(r2, r6, r4));
+                        append(blocks, loadp(r2, r0));
+                } else {
+                        append(blocks, add(r1, r1, r7));
+                        append(blocks, loadval(r4, 0));
+                        append(blocks, sload(r2, r6, r4));
+                        append(blocks, loadval(r3, 0));
+                        append(blocks, cmov(r3, r2, r1));
+                        append(blocks, loadval(r5, body + 8));
+                        append(blocks, cmov(r5, r0, r1));
+                        append(blocks, loadp(r3, r5));
+                        append(blocks, halt());
+                }
+        }
+        block_start[num_blocks] = Seq_length(blocks);
+
+        uint32_t num_words = block_start[num_blocks];
+        uint32_t setup = loop_head_length(iterations) + 2 + 4 * num_blocks +
+                         4 * num_words + 3;
+        assert(setup + num_words < LOADVAL_LIMIT);
+
+        loop_head(stream, iterations);
+        append(stream, loadval(r5, num_blocks));
+        append(stream, activate(r6, r5));
+        for (unsigned i = 0; i < num_blocks; i++) {
+                uint32_t length = block_start[i + 1] - block_start[i];
+                append(stream, loadval(r5, length));
+                append(stream, activate(r2, r5));
+                append(stream, loadval(r4, i));
+                append(stream, sstore(r6, r4, r2));
+                for (uint32_t j = 0; j < length; j++) {
+                        append(stream, loadval(r4, setup + block_start[i]
+                                                   + j));
+                        append(stream, sload(r5, r0, r4));
+                        append(stream, loadval(r4, j));
+                        append(stream, sstore(r2, r4, r5));
+                }
+        }
+        append(stream, loadval(r4, 0));
+        append(stream, sload(r2, r6, r4));
+        append(stream, loadp(r2, r0));
+        assert((uint32_t)Seq_length(stream) == setup);
+
+        /* The blocks follow as data */
+        while (Seq_length(blocks) > 0) {
+                Seq_addhi(stream, Seq_remlo(blocks));
+        }
+        Seq_free(&blocks);
+
+        uint64_t per_iteration = (uint64_t)(num_blocks - 1) * (body + 3) +
+                                 body + 8;
+        return setup + (uint64_t)iterations * per_iteration + 1;
+}
+
+/* IO-heavy stream: reads characters until end of input and writes each one
+ * echoes times. The count assumes input_bytes characters of input */
+uint64_t build_io_workload(Seq_T stream, uint64_t input_bytes,
+                           unsigned echoes)
+{
+        assert(Seq_length(stream) == 0);
+        append(stream, loadval(r0, 0));
+
+        uint32_t top = Seq_length(stream);
+        uint32_t exit = top + 8 + echoes;
+        append(stream, input(r3));
+        append(stream, nand(r4, r3, r3));
+        append(stream, loadval(r5, exit));
+        append(stream, loadval(r2, top + 6));
+        append(stream, cmov(r5, r2, r4));
+        append(stream, loadp(r0, r5));
+        for (unsigned i = 0; i < echoes; i++) {
+                append(stream, output(r3));
+        }
+        append(stream, loadval(r2, top));
+        append(stream, loadp(r0, r2));
+        assert((uint32_t)Seq_length(stream) == exit);
+        append(stream, halt());
+
+        return 1 + input_bytes * (8 + echoes) + 7;
+}
+
+/* Writes the given workload to name.um and prints its instruction count */
+void Um_write_workload(const char *name, Seq_T stream, uint64_t instructions)
+{
+        char filename[256];
+        snprintf(filename, sizeof(filename), "%s.um", name);
+        FILE *output = fopen(filename, "wb");
+        assert(output != NULL);
+        Um_write_sequence(output, stream);
+        fclose(output);
+        printf("%s %llu instructions\n", filename,
+               (unsigned long long)instructions);
+}
@@ -0,0 +1,339 @@
+/**************************************************************
+ *
+ *                     umtoc.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Translates a .um program ahead of time into a C file that
+ *              links against the um runtime. Every instruction becomes a
+ *              few lines of C under its own label, with the registers held
+ *              in locals, and a LOADP of the 0 segment jumps through a
+ *              switch on the new program counter. The translation is only
+ *              valid while the 0 segment holds the original program, so a
+ *              store into the 0 segment, a LOADP of another segment or an
+ *              invalid instruction hands the machine to the threaded
+ *              engine, which runs the rest of the program.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "decode.h"
+#include "load_words.h"
+
+/* Declarations for the helpers */
+static uint32_t *read_program(const char *fname, size_t *num_words);
+static void write_program(FILE *out, const char *fname,
+                          const uint32_t *words, size_t num_words);
+static void write_instruction(FILE *out, size_t index, Um_decoded inst);
+static void usage(char *prog_name);
+
+/****************** main *******************
+ *
+ * Translates the program named on the command line.
+ *
+ * Parameters:
+ *         int argc:   number of arguments passed into the program
+ *      char *argv[]:  the .um program, and optionally -o and the C file to
+ *                     write, which is stdout otherwise
+ * Returns:
+ *      EXIT_SUCCESS, or EXIT_FAILURE if a file cannot be read or written
+ *
+ ********************************************/
+int main(int argc, char *argv[])
+{
+        const char *fname = NULL;
+        const char *out_name = NULL;
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                        out_name = argv[++i];
+                } else if (argv[i][0] != '-' && fname == NULL) {
+                        fname = argv[i];
+                } else {
+                        usage(argv[0]);
+                }
+        }
+        if (fname == NULL) {
+                usage(argv[0]);
+        }
+
+        size_t num_words;
+        uint32_t *words = read_program(fname, &num_words);
+
+        FILE *out = out_name == NULL ? stdout : fopen(out_name, "w");
+        if (out == NULL) {
+                fprintf(stderr, "Error: Could not write %s\n", out_name);
+                return EXIT_FAILURE;
+        }
+        write_program(out, fname, words, num_words);
+        free(words);
+
+        bool written = ferror(out) == 0;
+        if (fclose(out) != 0 || !written) {
+                fprintf(stderr, "Error: Could not write %s\n",
+                        out_name == NULL ? "stdout" : out_name);
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
+
+/****************** read_program *******************
+ *
+ * Reads the big-endian words of a .um program into host words.
+ *
+ * Parameters:
+ *      const char *fname: the program
+ *      size_t *num_words: set to the number of words read
+ * Returns:
+ *      the words, which the caller must free
+ * Expects:
+ *      Exits with an error message if the file cannot be read or its size
+ *      is not a multiple of 4 bytes.
+ *
+ ********************************************/
+static uint32_t *read_program(const char *fname, size_t *num_words)
+{
+        struct stat statistics;
+        FILE *fp = fopen(fname, "rb");
+        if (fp == NULL || fstat(fileno(fp), &statistics) != 0 ||
+            statistics.st_size % 4 != 0) {
+                fprintf(stderr, "Error: Could not read program %s\n", fname);
+                exit(EXIT_FAILURE);
+        }
+
+        size_t num_bytes = (size_t)statistics.st_size;
+        uint32_t *words = malloc(num_bytes + sizeof(uint32_t));
+        if (words == NULL ||
+            fread(words, 1, num_bytes, fp) != num_bytes) {
+                fprintf(stderr, "Error: Could not read program %s\n", fname);
+                exit(EXIT_FAILURE);
+        }
+        fclose(fp);
+
+        /* Convert the words where they are */
+        *num_words = num_bytes / 4;
+        load_big_endian(words, (unsigned char *)words, *num_words);
+        return words;
+}
+
+/****************** write_program *******************
+ *
+ * Writes the C translation of a program: its words, a function that runs
+ * them, and a main that loads them into a new machine and calls it.
+ *
+ * Parameters:
+ *      FILE *out:             the C file
+ *      const char *fname:     name of the program, for the comments
+ *      const uint32_t *words: the words of the program
+ *      size_t num_words:      number of words
+ * Returns:
+ *      None
+ * Notes:
+ *      The labels, the dispatch switch, the program counter and the hand
+ *      off to the interpreter are only written when something uses them,
+ *      so that the file compiles cleanly with every warning turned on.
+ *
+ ********************************************/
+static void write_program(FILE *out, const char *fname,
+                          const uint32_t *words, size_t num_words)
+{
+        /* Find out which parts of the run function are needed */
+        bool has_loadp = false;
+        bool has_interpreter = false;
+        bool uses_space = false;
+        for (size_t i = 0; i < num_words; i++) {
+                Um_opcode op = decode_instruction(words[i]).op;
+                has_loadp |= op == LOADP;
+                has_interpreter |= op == SSTORE || op == LOADP || op > LV;
+                uses_space |= op == SLOAD || op == SSTORE || op == MAP ||
+                              op == UNMAP;
+        }
+        uses_space |= has_interpreter;
+
+        fprintf(out, "/* %s translated to C by umtoc */\n\n", fname);
+        fprintf(out, "#include <stdlib.h>\n#include <stdio.h>\n"
+                     "#include <string.h>\n"
+                     "#include \"segment_private.h\"\n"
+                     "#include \"operations.h\"\n"
+                     "#include \"read_and_execute.h\"\n"
+                     "#include \"threaded_execute.h\"\n\n");
+
+        /* The words still form the 0 segment, for SLOAD and the
+         * interpreter */
+        fprintf(out, "#define NUM_WORDS %zu\n\n", num_words);
+        fprintf(out, "static const uint32_t program_words[%zu] = {",
+                num_words > 0 ? num_words : 1);
+        for (size_t i = 0; i < num_words; i++) {
+                fputs(i % 5 == 0 ? "\n        " : " ", out);
+                fprintf(out, "0x%08xu,", words[i]);
+        }
+        fprintf(out, "%s\n};\n\n", num_words > 0 ? "" : " 0");
+
+        /* The registers are copied back to the machine when the run ends
+         * or the interpreter takes over */
+        fprintf(out, "#define SAVE_REGISTERS() do { \\\n"
+                     "        vm->registers[0] = r0; "
+                     "vm->registers[1] = r1; \\\n"
+                     "        vm->registers[2] = r2; "
+                     "vm->registers[3] = r3; \\\n"
+                     "        vm->registers[4] = r4; "
+                     "vm->registers[5] = r5; \\\n"
+                     "        vm->registers[6] = r6; "
+                     "vm->registers[7] = r7; \\\n"
+                     "} while (0)\n\n");
+
+        fprintf(out, "static void run(Machine vm)\n{\n");
+        if (uses_space) {
+                fprintf(out, "        Address_space space = vm->space;\n");
+        }
+        fprintf(out, "        uint32_t r0 = 0, r1 = 0, r2 = 0, r3 = 0, "
+                     "r4 = 0, r5 = 0, r6 = 0, r7 = 0;\n");
+        if (has_loadp) {
+                fprintf(out, "        uint32_t pc;\n");
+        }
+        fprintf(out, "\n");
+
+        for (size_t i = 0; i < num_words; i++) {
+                if (has_loadp) {
+                        fprintf(out, "L%zu:\n", i);
+                }
+                write_instruction(out, i, decode_instruction(words[i]));
+        }
+        fprintf(out, "        goto done;\n\n");
+
+        /* A LOADP of the 0 segment can land on any instruction, and one
+         * past the end stops the program as it does in the interpreter */
+        if (has_loadp) {
+                fprintf(out, "dispatch:\n        switch (pc) {\n");
+                for (size_t i = 0; i < num_words; i++) {
+                        fprintf(out, "        case %zu: goto L%zu;\n", i, i);
+                }
+                fprintf(out, "        default: goto done;\n        }\n\n");
+        }
+
+        /* Anything the translation cannot run is left to the interpreter,
+         * starting at the instruction it could not run */
+        if (has_interpreter) {
+                fprintf(out, "interpret:\n        SAVE_REGISTERS();\n"
+                             "        execute_threaded(vm, "
+                             "space->segments[0]->length);\n"
+                             "        return;\n");
+        }
+        fprintf(out, "done:\n        SAVE_REGISTERS();\n}\n\n");
+
+        fprintf(out, "int main(void)\n{\n"
+                     "        Machine vm = new_machine(OUTPUT_DEFAULT);\n"
+                     "        map_segment(vm->space, NULL, 0, 0, NUM_WORDS, "
+                     "true);\n"
+                     "        if (NUM_WORDS > 0) {\n"
+                     "                memcpy(word_at(vm->space, 0, 0), "
+                     "program_words,\n"
+                     "                       sizeof(program_words));\n"
+                     "        }\n"
+                     "        decode_program(vm->space);\n"
+                     "        run(vm);\n"
+                     "        const char *failure = vm->failure;\n"
+                     "        uint32_t failed_at = vm->prog_counter;\n"
+                     "        free_machine(&vm);\n"
+                     "        if (failure != NULL) {\n"
+                     "                fprintf(stderr, \"Error: %%s at "
+                     "instruction %%u\\n\",\n"
+                     "                        failure, failed_at);\n"
+                     "                return EXIT_FAILURE;\n"
+                     "        }\n"
+                     "        return EXIT_SUCCESS;\n}\n");
+}
+
+/****************** write_instruction *******************
+ *
+ * Writes the C for one instruction.
+ *
+ * Parameters:
+ *      FILE *out:        the C file
+ *      size_t index:     where the instruction is in the 0 segment
+ *      Um_decoded inst:  the instruction, decoded but not fused
+ * Returns:
+ *      None
+ *
+ ********************************************/
+static void write_instruction(FILE *out, size_t index, Um_decoded inst)
+{
+        unsigned a = inst.a, b = inst.b, c = inst.c;
+        switch ((Um_opcode)inst.op) {
+        case CMOV:
+                fprintf(out, "        if (r%u != 0) r%u = r%u;\n", c, a, b);
+                break;
+        case SLOAD:
+                fprintf(out, "        r%u = *segment_word(space, r%u, r%u);\n",
+                        a, b, c);
+                break;
+        case SSTORE:
+                fprintf(out, "        if (r%u == 0) { vm->prog_counter = %zu; "
+                             "goto interpret; }\n"
+                             "        *writable_word(space, r%u, r%u) = r%u;\n",
+                        a, index, a, b, c);
+                break;
+        case ADD:
+                fprintf(out, "        r%u = r%u + r%u;\n", a, b, c);
+                break;
+        case MUL:
+                fprintf(out, "        r%u = r%u * r%u;\n", a, b, c);
+                break;
+        case DIV:
+                fprintf(out, "        r%u = r%u / r%u;\n", a, b, c);
+                break;
+        case NAND:
+                fprintf(out, "        r%u = ~(r%u & r%u);\n", a, b, c);
+                break;
+        case HALT:
+                fprintf(out, "        halt(vm); goto done;\n");
+                break;
+        case MAP:
+                fprintf(out, "        { uint32_t t[2] = { 0, r%u }; "
+                             "map_segment(space, t, 0, 1, 0, false); "
+                             "r%u = t[0]; }\n", c, b);
+                break;
+        case UNMAP:
+                fprintf(out, "        { uint32_t t = r%u; "
+                             "unmap_segment(space, &t, 0); }\n", c);
+                break;
+        case OUT:
+                fprintf(out, "        { uint32_t t = r%u; "
+                             "output(vm->out, &t, 0); }\n", c);
+                break;
+        case IN:
+                fprintf(out, "        { uint32_t t; "
+                             "input(vm->in, vm->out, &t, 0); r%u = t; }\n", c);
+                break;
+        case LOADP:
+                fprintf(out, "        if (r%u != 0) { vm->prog_counter = %zu; "
+                             "goto interpret; }\n"
+                             "        pc = r%u; goto dispatch;\n",
+                        b, index, c);
+                break;
+        case LV:
+                fprintf(out, "        r%u = 0x%xu;\n", a, inst.val);
+                break;
+        default:
+                fprintf(out, "        vm->prog_counter = %zu; "
+                             "goto interpret;\n", index);
+                break;
+        }
+}
+
+/****************** usage *******************
+ *
+ * Prints a usage message to stderr and exits with a failure status.
+ *
+ ********************************************/
+static void usage(char *prog_name)
+{
+        fprintf(stderr, "Usage: %s <program.um> [-o <file.c>]\n", prog_name);
+        exit(EXIT_FAILURE);
+}
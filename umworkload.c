@@ -0,0 +1,117 @@
+/**************************************************************
+ *
+ *                     umworkload.c
+ *
+ *     Assignment: HW 6: um
+ *        Authors: Dan Glorioso & Brandon Dionisio (dglori02 & bdioni01)
+ *           Date: 04/11/24
+ *
+ *     Summary: Writes the synthetic workloads built by umlab.c that "make
+ *              bench" times: an arithmetic loop, MAP/UNMAP churn, random
+ *              loads and stores over a 4 MB segment, code that hops between
+ *              segments with LOADP, and an echo of 4 MB of input. Each
+ *              program is written to <name>.um, the input of the IO
+ *              workload to io_workload.0, and the exact number of
+ *              instructions each program executes is printed on stdout.
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <seq.h>
+
+/* Generators in umlab.c */
+extern uint64_t build_arith_workload(Seq_T stream, uint32_t iterations,
+                                     unsigned adds, unsigned muls,
+                                     unsigned divs, unsigned nands);
+extern uint64_t build_churn_workload(Seq_T stream, uint32_t iterations,
+                                     const uint32_t *lengths,
+                                     unsigned num_lengths);
+extern uint64_t build_memory_workload(Seq_T stream, uint32_t iterations,
+                                      unsigned log_length, unsigned loads,
+                                      unsigned stores);
+extern uint64_t build_loadp_workload(Seq_T stream, uint32_t iterations,
+                                     unsigned num_blocks, unsigned body);
+extern uint64_t build_io_workload(Seq_T stream, uint64_t input_bytes,
+                                  unsigned echoes);
+extern void Um_write_workload(const char *name, Seq_T stream,
+                              uint64_t instructions);
+
+/* Segment lengths of the churn workload: mostly tiny segments, with a few
+ * up to 1K words */
+static const uint32_t churn_lengths[] = {
+        1, 1, 1, 1, 4, 4, 16, 64, 256, 1024
+};
+
+/* Iterations of each looping workload and characters of input echoed by
+ * the IO workload, before scaling. The iteration counts are 32-bit
+ * registers, which limits the scale to UINT32_MAX / ARITH_ITERATIONS */
+#define ARITH_ITERATIONS 2000000
+#define CHURN_ITERATIONS 500000
+#define MEMORY_ITERATIONS 1000000
+#define LOADP_ITERATIONS 200000
+#define IO_INPUT_BYTES (4 * 1024 * 1024)
+
+/****************** main *******************
+ *
+ * Writes every workload, scaled by the optional argument.
+ *
+ * Parameters:
+ *         int argc:   number of arguments passed into the program
+ *      char *argv[]:  optionally, a whole number that multiplies the
+ *                     iterations of every workload (1 by default), at
+ *                     most UINT32_MAX / ARITH_ITERATIONS
+ * Returns:
+ *      EXIT_SUCCESS, or EXIT_FAILURE if the scale is not valid or the input
+ *      file cannot be written
+ * Notes:
+ *      At scale 1 every workload executes 30 to 60 million instructions.
+ *
+ ********************************************/
+int main(int argc, char *argv[])
+{
+        uint64_t scale = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+        if (argc > 2 || scale == 0 || scale > UINT32_MAX / ARITH_ITERATIONS) {
+                fprintf(stderr, "Usage: %s [scale]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        Seq_T stream = Seq_new(0);
+        uint64_t count;
+
+        count = build_arith_workload(stream, ARITH_ITERATIONS * scale, 10, 4,
+                                     2, 4);
+        Um_write_workload("arith_workload", stream, count);
+
+        count = build_churn_workload(stream, CHURN_ITERATIONS * scale,
+                                     churn_lengths,
+                                     sizeof(churn_lengths) /
+                                     sizeof(uint32_t));
+        Um_write_workload("churn_workload", stream, count);
+
+        count = build_memory_workload(stream, MEMORY_ITERATIONS * scale, 20,
+                                      6, 2);
+        Um_write_workload("memory_workload", stream, count);
+
+        count = build_loadp_workload(stream, LOADP_ITERATIONS * scale, 16, 8);
+        Um_write_workload("loadp_workload", stream, count);
+
+        /* The IO workload needs its input written beside it */
+        uint64_t input_bytes = IO_INPUT_BYTES * scale;
+        FILE *input = fopen("io_workload.0", "wb");
+        if (input == NULL) {
+                perror("io_workload.0");
+                return EXIT_FAILURE;
+        }
+        for (uint64_t i = 0; i < input_bytes; i++) {
+                fputc(i % 64 == 63 ? '\n' : 'a' + i % 26, input);
+        }
+        fclose(input);
+
+        count = build_io_workload(stream, input_bytes, 2);
+        Um_write_workload("io_workload", stream, count);
+
+        Seq_free(&stream);
+        return EXIT_SUCCESS;
+}